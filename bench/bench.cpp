@@ -0,0 +1,713 @@
+// Micro-benchmarks for the ferret runtime primitives.
+//
+// The allocator and RC policy are compile time choices, so `make bench`
+// builds this file once per configuration. Each binary prints a single JSON
+// object, the Makefile collects them into an array. Keep benchmark names and
+// key order stable, they are what regressions are tracked by.
+
+#define FERRET_DISABLE_STD_MAIN TRUE
+#include "../f.cpp"
+
+#if !defined(FERRET_BENCH_VERSION)
+  #define FERRET_BENCH_VERSION "unknown"
+#endif
+
+#if !defined(FERRET_BENCH_REPEAT)
+  #define FERRET_BENCH_REPEAT 5
+#endif
+
+// Without reference counting nothing is freed, a run keeps the garbage of
+// every benchmark. Those runs do fewer iterations to stay within memory.
+#if !defined(FERRET_BENCH_SCALE)
+  #if defined(FERRET_DISABLE_RC)
+    #define FERRET_BENCH_SCALE 50
+  #else
+    #define FERRET_BENCH_SCALE 1
+  #endif
+#endif
+
+namespace bench{
+  using namespace ferret;
+
+  typedef ::std::chrono::steady_clock clock;
+
+  template<typename T>
+  inline void do_not_optimize(T const & v){
+    asm volatile("" : : "g"(&v) : "memory");
+  }
+
+  struct result{
+    ::std::string name;
+    size_t        iterations;
+    double        ns_per_op;
+  };
+
+  ::std::vector<result> results;
+
+  // Run body(n) FERRET_BENCH_REPEAT times, keep the median time per op.
+  template<typename F>
+  void measure(::std::string const & name, size_t n, F body){
+    n = (n + FERRET_BENCH_SCALE - 1) / FERRET_BENCH_SCALE;
+    ::std::vector<double> samples;
+    body(n / 10 + 1);
+    for(int r = 0; r < FERRET_BENCH_REPEAT; r++){
+      auto begin = clock::now();
+      body(n);
+      auto end = clock::now();
+      double ns = (double)::std::chrono::duration_cast<::std::chrono::nanoseconds>(end - begin).count();
+      samples.push_back(ns / (double)n);
+    }
+    ::std::sort(samples.begin(), samples.end());
+    results.push_back(result{name, n, samples[samples.size() / 2]});
+  }
+
+  ::std::string sized(const char * name, size_t n){
+    return ::std::string(name) + "/n=" + ::std::to_string(n);
+  }
+
+  class identity final : public lambda_i {
+  public:
+    var invoke(var const & args) const final { return runtime::first(args); }
+  };
+
+  class inc final : public lambda_i {
+  public:
+    var invoke(var const & args) const final {
+      return obj<number>(number::to<real_t>(runtime::first(args)) + 1);
+    }
+  };
+
+  class plus final : public lambda_i {
+  public:
+    var invoke(var const & args) const final {
+      if (args.is_nil())
+        return obj<number>(0);
+      return obj<number>(number::to<real_t>(runtime::first(args)) +
+                         number::to<real_t>(runtime::first(runtime::rest(args))));
+    }
+  };
+
+  var make_list(size_t n){
+    var l;
+    for(size_t i = 0; i < n; i++)
+      l = runtime::cons(obj<number>(i), l);
+    return l;
+  }
+
+  var make_map(size_t n){
+    var m = obj<d_list>();
+    for(size_t i = 0; i < n; i++)
+      m = m.cast<d_list>()->assoc(obj<keyword>((number_t)i), obj<number>(i));
+    return m;
+  }
+
+  const char * allocator_name(){
+  #if defined(FERRET_MEMORY_BOEHM_GC)
+    return "gc";
+  #elif defined(FERRET_MEMORY_POOL_SIZE) && !defined(FERRET_DISABLE_MULTI_THREADING)
+    return "synchronized";
+  #elif defined(FERRET_MEMORY_POOL_SIZE)
+    return "pool";
+  #else
+    return "system";
+  #endif
+  }
+
+  const char * list_name(){
+  #if defined(FERRET_COMPACT_CONS)
+    return "compact";
+  #else
+    return "sequence";
+  #endif
+  }
+
+  const char * rc_name(){
+  #if defined(FERRET_DISABLE_RC)
+    return "no_rc";
+  #elif defined(FERRET_DISABLE_MULTI_THREADING)
+    return "rc";
+  #else
+    return "atomic_rc";
+  #endif
+  }
+
+  void allocation(){
+    measure("obj/number", 1000000, [](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var v = obj<number>(i);
+          do_not_optimize(v);
+        }
+      });
+
+    measure("obj/sequence", 1000000, [](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var v = obj<sequence>();
+          do_not_optimize(v);
+        }
+      });
+  }
+
+  void reference_counting(){
+    var v = obj<number>(42);
+
+    measure("var/copy", 10000000, [&v](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var c(v);
+          do_not_optimize(c);
+        }
+      });
+
+    measure("var/move", 10000000, [&v](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var m(::std::move(v));
+          do_not_optimize(m);
+          v = ::std::move(m);
+        }
+      });
+  }
+
+  void accumulators(){
+    var one = obj<number>(1);
+
+    measure("number/add", 1000000, [&one](size_t n){
+        var acc = obj<number>(0);
+        for(size_t i = 0; i < n; i++)
+          acc = acc.cast<number>()->add(one);
+        do_not_optimize(acc);
+      });
+
+    measure("number/add_in_place", 1000000, [&one](size_t n){
+        var acc = obj<number>(0);
+        for(size_t i = 0; i < n; i++)
+          acc = number::add(::std::move(acc), one);
+        do_not_optimize(acc);
+      });
+
+    measure("d_list/assoc_in_place/n=64", 1000, [&one](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var m = obj<d_list>();
+          for(size_t k = 0; k < 64; k++)
+            m = d_list::assoc(::std::move(m), obj<keyword>((number_t)k), one);
+          do_not_optimize(m);
+        }
+      });
+  }
+
+  void sequences(){
+    for(size_t size : {100, 10000}){
+      var l = make_list(size);
+
+      measure(sized("list/first", size), 1000000, [&l](size_t n){
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(runtime::first(l));
+        });
+
+      measure(sized("list/rest", size), 1000000 / size + 1, [&l](size_t n){
+          for(size_t i = 0; i < n; i++)
+            for(var it = l; !it.is_nil(); it = runtime::rest(it))
+              do_not_optimize(it);
+        });
+
+      measure(sized("list/reduce", size), 1000000 / size + 1, [&l](size_t n){
+          struct counter final : public reducer_i {
+            bool step(var &, var const &) final { return true; }
+          } rf;
+          for(size_t i = 0; i < n; i++){
+            var acc;
+            runtime::reduce(rf, acc, l);
+          }
+        });
+
+      measure(sized("list/count", size), 1000000 / size + 1, [&l](size_t n){
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(runtime::count(l));
+        });
+
+      measure(sized("list/nth", size), 1000000 / size + 1, [&l, size](size_t n){
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(runtime::nth(l, (number_t)(size - 1)));
+        });
+    }
+  }
+
+  void ranges(){
+    var r = integer_range::from(0, 1000000);
+
+    measure("range/reduce/n=1000000", 10, [&r](size_t n){
+        struct counter final : public reducer_i {
+          bool step(var &, var const &) final { return true; }
+        } rf;
+        for(size_t i = 0; i < n; i++){
+          var acc;
+          runtime::reduce(rf, acc, r);
+        }
+      });
+
+    measure("range/nth/n=1000000", 1000000, [&r](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(runtime::nth(r, (number_t)i));
+      });
+
+    measure("range/count/n=1000000", 1000000, [&r](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(runtime::count(r));
+      });
+  }
+
+  void maps(){
+    for(size_t size : {4, 16, 64}){
+      var m = make_map(size);
+      var key = obj<keyword>((number_t)(size / 2));
+      var args = runtime::list(key);
+
+      measure(sized("d_list/assoc", size), 100000, [&m, size](size_t n){
+          var k = obj<keyword>((number_t)size);
+          var v = obj<number>(size);
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(m.cast<d_list>()->assoc(k, v));
+        });
+
+      measure(sized("d_list/lookup", size), 100000, [&m, &args](size_t n){
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(m.cast<d_list>()->val_at(args));
+        });
+    }
+
+    for(size_t size : {4, 8}){
+      var m = obj<array_map>();
+      for(size_t i = 0; i < size; i++)
+        m = m.cast<array_map>()->assoc(obj<keyword>((number_t)i), obj<number>(i));
+      var args = runtime::list(obj<keyword>((number_t)(size / 2)));
+
+      measure(sized("array_map/assoc", size), 100000, [&m, size](size_t n){
+          var k = obj<keyword>((number_t)(size - 1));
+          var v = obj<number>(size);
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(m.cast<array_map>()->assoc(k, v));
+        });
+
+      measure(sized("array_map/lookup", size), 100000, [&m, &args](size_t n){
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(m.cast<array_map>()->val_at(args));
+        });
+    }
+
+    for(size_t size : {64, 10000}){
+      var m = obj<sorted_map>();
+      for(size_t i = 0; i < size; i++)
+        m = m.cast<sorted_map>()->assoc(obj<number>(i), obj<number>(i));
+      var args = runtime::list(obj<number>(size / 2));
+
+      measure(sized("sorted_map/assoc", size), 100000, [&m, size](size_t n){
+          var k = obj<number>(size / 3);
+          var v = obj<number>(size);
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(m.cast<sorted_map>()->assoc(k, v));
+        });
+
+      measure(sized("sorted_map/lookup", size), 100000, [&m, &args](size_t n){
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(m.cast<sorted_map>()->val_at(args));
+        });
+
+      measure(sized("sorted_map/subseq_reduce", size), 1000, [&m, size](size_t n){
+          struct counter final : public reducer_i {
+            bool step(var &, var const &) final { return true; }
+          } rf;
+          var lo = obj<number>(size / 4);
+          var hi = obj<number>(size / 2);
+          for(size_t i = 0; i < n; i++){
+            var acc;
+            runtime::reduce(rf, acc, m.cast<sorted_map>()->subseq(lo, true, hi, false));
+          }
+        });
+    }
+  }
+
+  void sets(){
+    for(size_t size : {16, 10000}){
+      var s = obj<hash_set>();
+      var t = obj<hash_set>();
+      for(size_t i = 0; i < size; i++){
+        s = s.cast<hash_set>()->conj(obj<number>(i));
+        t = t.cast<hash_set>()->conj(obj<number>(i + size / 2));
+      }
+      var x = obj<number>(size / 2);
+
+      measure(sized("hash_set/conj", size), 100000, [&s, size](size_t n){
+          var k = obj<number>(size);
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(s.cast<hash_set>()->conj(k));
+        });
+
+      measure(sized("hash_set/contains", size), 100000, [&s, &x](size_t n){
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(s.cast<hash_set>()->contains(x));
+        });
+
+      measure(sized("hash_set/union", size), 100, [&s, &t](size_t n){
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(s.cast<hash_set>()->unite(t));
+        });
+
+      measure(sized("hash_set/intersection", size), 100, [&s, &t](size_t n){
+          for(size_t i = 0; i < n; i++)
+            do_not_optimize(s.cast<hash_set>()->intersect(t));
+        });
+    }
+  }
+
+  void builders(){
+    std_vector items;
+    for(size_t i = 0; i < 1000; i++)
+      items.push_back(obj<number>(i));
+
+    measure("build/cons/n=1000", 1000, [&items](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var l;
+          for(auto const& it : items)
+            l = runtime::cons(it, l);
+          do_not_optimize(l);
+        }
+      });
+
+    measure("build/sequence_from/n=1000", 1000, [&items](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(sequence::from(items));
+      });
+
+    measure("build/d_list_assoc/n=64", 1000, [&items](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var m = obj<d_list>();
+          for(size_t k = 0; k < 64; k++)
+            m = m.cast<d_list>()->assoc(obj<keyword>((number_t)k), items[k]);
+          do_not_optimize(m);
+        }
+      });
+
+    measure("build/d_list_transient/n=64", 1000, [&items](size_t n){
+        for(size_t i = 0; i < n; i++){
+          transient t(runtime::type::d_list, 64);
+          for(size_t k = 0; k < 64; k++)
+            t.assoc(obj<keyword>((number_t)k), items[k]);
+          do_not_optimize(t.persistent());
+        }
+      });
+
+    measure("build/hash_map_assoc/n=1000", 100, [&items](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var m = obj<hash_map>();
+          for(auto const& it : items)
+            m = m.cast<hash_map>()->assoc(it, it);
+          do_not_optimize(m);
+        }
+      });
+
+    measure("build/hash_map_transient/n=1000", 100, [&items](size_t n){
+        for(size_t i = 0; i < n; i++){
+          transient t(runtime::type::hash_map, items.size());
+          for(auto const& it : items)
+            t.assoc(it, it);
+          do_not_optimize(t.persistent());
+        }
+      });
+
+    measure("build/sorted_map_assoc/n=1000", 100, [&items](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var m = obj<sorted_map>();
+          for(auto const& it : items)
+            m = m.cast<sorted_map>()->assoc(it, it);
+          do_not_optimize(m);
+        }
+      });
+
+    measure("build/sorted_map_transient/n=1000", 100, [&items](size_t n){
+        for(size_t i = 0; i < n; i++){
+          transient t(runtime::type::sorted_map, items.size());
+          for(auto const& it : items)
+            t.assoc(it, it);
+          do_not_optimize(t.persistent());
+        }
+      });
+  }
+
+  void strings(){
+    const char * text = "the quick brown fox jumps over the lazy dog";
+
+    measure("string/construct", 100000, [text](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(obj<string>(text));
+      });
+
+    var s = obj<string>(text);
+    ::std::ostringstream sink;
+    ::std::streambuf * out = ::std::cout.rdbuf(sink.rdbuf());
+    measure("string/print", 100000, [&s, &sink](size_t n){
+        for(size_t i = 0; i < n; i++){
+          s.stream_console();
+          sink.str("");
+        }
+      });
+    ::std::cout.rdbuf(out);
+
+    // Builds a 43k character text from 1000 pieces.
+    var piece = obj<string>(text);
+
+    measure("rope/append/n=1000", 10, [&piece](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var r = obj<rope>(::std::string());
+          for(size_t k = 0; k < 1000; k++)
+            r = rope::concat(r, piece);
+          do_not_optimize(r);
+        }
+      });
+
+    var r = obj<rope>(::std::string());
+    for(size_t k = 0; k < 1000; k++)
+      r = rope::concat(r, piece);
+
+    measure("rope/slice/n=1000", 100000, [&r](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(r.cast<rope>()->sub(i % 20000, i % 20000 + 1000));
+      });
+
+    measure("rope/rest/n=1000", 1000, [&r](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var it = r;
+          for(size_t k = 0; k < 1000; k++)
+            it = runtime::rest(it);
+          do_not_optimize(it);
+        }
+      });
+
+    measure("rope/flatten/n=1000", 1000, [&r](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(string::to<::std::string>(r).size());
+      });
+
+    ::std::string page;
+    while (page.size() < 65536)
+      page += text;
+    const char * needle = "lazy cat";
+
+    measure("text/is_utf8/n=65536", 10000, [&page](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(text::is_utf8(page.data(), page.size()));
+      });
+
+    measure("text/find/n=65536", 10000, [&page, needle](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(text::find(page.data(), page.size(), needle, 8));
+      });
+
+    measure("text/compare/n=65536", 10000, [&page](size_t n){
+        ::std::string other = page;
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(text::compare(page.data(), page.size(), other.data(), other.size()));
+      });
+  }
+
+  void formatting(){
+    var n = obj<number>(3.14159265);
+    ::std::ostringstream sink;
+    ::std::streambuf * out = ::std::cout.rdbuf(sink.rdbuf());
+    measure("number/print", 100000, [&n, &sink](size_t k){
+        for(size_t i = 0; i < k; i++){
+          n.stream_console();
+          sink.str("");
+        }
+      });
+    ::std::cout.rdbuf(out);
+
+    measure("number/format_shortest", 1000000, [](size_t k){
+        char buffer[decimal::buffer_size];
+        for(size_t i = 0; i < k; i++)
+          do_not_optimize(decimal::format_shortest(1.0 / (double)(i + 3), buffer));
+      });
+
+    const char * text = "-12345.678901e-3";
+    measure("number/parse", 1000000, [text](size_t k){
+        double d = 0;
+        for(size_t i = 0; i < k; i++){
+          decimal::parse(text, text + 16, d);
+          do_not_optimize(d);
+        }
+      });
+  }
+
+  void serialization(){
+    var l = make_list(10000);
+    var m = make_map(64);
+
+    measure("serial/encode_list/n=10000", 100, [&l](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(runtime::serialize(l));
+      });
+
+    var bytes = runtime::serialize(l);
+    measure("serial/decode_list/n=10000", 100, [&bytes](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(runtime::deserialize(bytes));
+      });
+
+    measure("serial/roundtrip_d_list/n=64", 10000, [&m](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(runtime::deserialize(runtime::serialize(m)));
+      });
+  }
+
+  void edn(){
+    ::std::string records;
+    for(size_t i = 0; i < 10000; i++)
+      records += "{:id " + ::std::to_string(i) + " :name \"record\" :score 0.75 :tags [1 2 3]}\n";
+    var block = obj<byte_block>(records.size());
+    ::memcpy(block.cast<byte_block>()->data(), records.data(), records.size());
+    var text = obj<string_slice>(block, block.cast<byte_block>()->data(), records.size());
+
+    measure("edn/read/n=10000", 10, [&text](size_t n){
+        for(size_t i = 0; i < n; i++)
+          for(var it = runtime::read_edn(text);
+              !it.is_type(runtime::type::empty_sequence); it = runtime::rest(it))
+            do_not_optimize(runtime::first(it));
+      });
+  }
+
+  void threads(){
+  #if !defined(FERRET_DISABLE_MULTI_THREADING)
+    var fn = obj<identity>();
+
+    measure("async/spawn_deref", 1000, [&fn](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var a = obj<async>(fn);
+          do_not_optimize(a.cast<async>()->deref());
+        }
+      });
+
+  #if defined(FERRET_POSIX)
+    measure("task/spawn_deref", 10000, [&fn](size_t n){
+        for(size_t i = 0; i < n; i++){
+          var t = obj<task>(fn);
+          do_not_optimize(t.cast<task>()->deref());
+        }
+      });
+  #endif
+
+    var sum = obj<plus>();
+    var numbers = sequence::from(std_vector(10000, obj<number>(1)));
+
+    measure("fold/sum/n=10000", 100, [&sum, &numbers](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(runtime::fold(numbers, sum, sum));
+      });
+
+    measure("pmap/n=10000", 100, [&fn, &numbers](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(runtime::pmap(fn, numbers, 512));
+      });
+
+    // Promises delivered last to first, the result must still be in
+    // input order.
+    auto gather = [](size_t n){
+      std_vector pending(n);
+      var inputs;
+      for(size_t i = n; i > 0; i--){
+        pending[i - 1] = obj<promise>();
+        inputs = runtime::cons(pending[i - 1], inputs);
+      }
+      var all = runtime::when_all(inputs);
+      for(size_t i = n; i > 0; i--)
+        pending[i - 1].cast<promise>()->deliver(obj<number>(i - 1));
+      return all.cast<promise>()->deref();
+    };
+
+    size_t expected = 0;
+    for(auto const& it : runtime::range(gather(100)))
+      if (number::to<size_t>(it) != expected++){
+        ::std::fprintf(stderr, "when_all: values out of order\n");
+        ::std::exit(1);
+      }
+
+    measure("when_all/n=100", 1000, [&gather](size_t n){
+        for(size_t i = 0; i < n; i++)
+          do_not_optimize(gather(100));
+      });
+
+    var f = obj<inc>();
+    ::std::vector<size_t> contention = {1, 2, 4};
+    if (::std::thread::hardware_concurrency() > 4)
+      contention.push_back(::std::thread::hardware_concurrency());
+
+    for(size_t threads : contention){
+      var a = obj<atomic>(obj<number>(0));
+
+      measure("atomic/swap/threads=" + ::std::to_string(threads), 100000, [&a, &f, threads](size_t n){
+          ::std::vector<::std::thread> pool;
+          for(size_t t = 0; t < threads; t++)
+            pool.push_back(::std::thread([&a, &f, n, threads](){
+                  for(size_t i = 0; i < n / threads; i++)
+                    a.cast<atomic>()->swap(f, nil());
+                }));
+          for(auto & t : pool)
+            t.join();
+        });
+    }
+
+    var config = obj<delayed>(obj<identity>());
+    config.cast<delayed>()->deref();
+
+    for(size_t threads : contention){
+      measure("delay/deref/threads=" + ::std::to_string(threads), 1000000, [&config, threads](size_t n){
+          ::std::vector<::std::thread> pool;
+          for(size_t t = 0; t < threads; t++)
+            pool.push_back(::std::thread([&config, n, threads](){
+                  for(size_t i = 0; i < n / threads; i++)
+                    do_not_optimize(config.cast<delayed>()->deref());
+                }));
+          for(auto & t : pool)
+            t.join();
+        });
+    }
+  #endif
+  }
+
+  void report(){
+    ::std::printf("{\"runtime\":\"%s\",", FERRET_BENCH_VERSION);
+    ::std::printf("\"config\":{\"allocator\":\"%s\",\"rc\":\"%s\",\"list\":\"%s\"},",
+                  allocator_name(), rc_name(), list_name());
+    ::std::printf("\"results\":[");
+    for(size_t i = 0; i < results.size(); i++)
+      ::std::printf("%s{\"name\":\"%s\",\"iterations\":%zu,\"ns_per_op\":%.3f}",
+                    (i == 0 ? "" : ","), results[i].name.c_str(),
+                    results[i].iterations, results[i].ns_per_op);
+    ::std::printf("],");
+    // Bytes per list cell, before any allocator overhead.
+    ::std::printf("\"node_bytes\":{\"sequence\":%zu", sizeof(sequence));
+  #if defined(FERRET_COMPACT_CONS)
+    ::std::printf(",\"cons_cell\":%zu", sizeof(cons_cell));
+  #endif
+    ::std::printf("}}\n");
+  }
+}
+
+int main(){
+  using namespace ferret;
+  FERRET_ALLOCATOR::init();
+  runtime::init();
+
+  bench::allocation();
+  bench::reference_counting();
+  bench::accumulators();
+  bench::sequences();
+  bench::ranges();
+  bench::maps();
+  bench::sets();
+  bench::builders();
+  bench::strings();
+  bench::formatting();
+  bench::serialization();
+  bench::edn();
+  bench::threads();
+  bench::report();
+
+  return 0;
+}
@@ -22,6 +22,13 @@
              # undef  FERRET_CONFIG_SAFE_MODE
              # define FERRET_STD_LIB TRUE
            #endif
+
+           #if defined(__APPLE__) ||                       \
+             defined(__linux__) ||                         \
+             defined(__unix__)
+
+             # define FERRET_POSIX TRUE
+           #endif
            
            #if defined(ARDUINO)
 
@@ -49,6 +56,10 @@
            # define FERRET_DISABLE_MULTI_THREADING TRUE
            # define FERRET_DISABLE_STD_OUT TRUE
          #endif
+
+         #if defined(FERRET_ENABLE_TRACE) && !defined(FERRET_STD_LIB)
+           # undef FERRET_ENABLE_TRACE
+         #endif
          #ifdef FERRET_STD_LIB
           #include <iostream>
           #include <iomanip>
@@ -64,6 +75,30 @@
           #include <mutex>
           #include <thread>
           #include <future>
+          #include <memory>
+          #include <deque>
+          #include <unordered_map>
+          #include <functional>
+          #include <stdexcept>
+          #include <condition_variable>
+          #include <queue>
+          #include <cstdint>
+          #include <cstring>
+         #endif
+
+         #ifdef FERRET_POSIX
+          #include <cstring>
+          #include <cerrno>
+          #include <unistd.h>
+          #include <fcntl.h>
+          #include <sys/mman.h>
+          #include <sys/stat.h>
+          #include <ucontext.h>
+          #include <time.h>
+         #endif
+
+         #if defined(__linux__)
+          #include <sys/prctl.h>
          #endif
 
          #ifdef FERRET_HARDWARE_ARDUINO
@@ -130,13 +165,14 @@
          #if !defined(FERRET_REAL_EPSILON)
             #define FERRET_REAL_EPSILON   0.00001
          #endif
+
+         #if !defined(FERRET_NUMBER_PRECISION)
+            #define FERRET_NUMBER_PRECISION 4
+         #endif
            
            typedef FERRET_NUMBER_TYPE           number_t;                   // Whole number Container.
            typedef FERRET_REAL_TYPE             real_t;                     // Real number Container.
            const   real_t                       real_epsilon(FERRET_REAL_EPSILON);
-         #if !defined(FERRET_DISABLE_STD_OUT)
-           const   size_t                       number_precision = 4;       // number Format String (fprinf)
-         #endif
          }
          namespace ferret{
            constexpr auto operator "" _pi(long double x) -> double {
@@ -361,6 +397,444 @@
            };
          }
 
+         // Number Formatting
+         #if defined(FERRET_STD_LIB)
+         namespace ferret{
+           // Decimal text of numbers without going through iostreams.
+           // Reals print either with a fixed number of decimals, correctly
+           // rounded as printf does, or with Grisu2 as a text that reads
+           // back to the same double and is the shortest such text for
+           // all but about 0.1% of doubles.
+           namespace decimal{
+             const int shortest = -1;
+
+             // Decimals printed, shortest for the shortest text that reads
+             // back. Starts at FERRET_NUMBER_PRECISION.
+             inline ::std::atomic<int> & precision(){
+               static ::std::atomic<int> digits(FERRET_NUMBER_PRECISION);
+               return digits;
+             }
+
+             const char digit_pairs[] =
+               "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+               "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+               "8081828384858687888990919293949596979899";
+
+             const uint64_t pow10[] = {
+               1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+               100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+               1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+               1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+               1000000000000000000ULL, 10000000000000000000ULL };
+
+             // Powers of ten that doubles hold exactly.
+             const double exact_pow10[] = {
+               1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+               1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+             // Room for any double in fixed notation up to 17 decimals.
+             const size_t buffer_size = 350;
+
+             // Two digits per step, written back to front. Returns the end.
+             inline char * format(uint64_t x, char * out){
+               char digits[20];
+               char * p = digits + 20;
+               while (x >= 100){
+                 unsigned i = (unsigned)(x % 100) * 2;
+                 x /= 100;
+                 *--p = digit_pairs[i + 1];
+                 *--p = digit_pairs[i];
+               }
+               if (x >= 10){
+                 unsigned i = (unsigned)x * 2;
+                 *--p = digit_pairs[i + 1];
+                 *--p = digit_pairs[i];
+               }else{
+                 *--p = (char)('0' + x);
+               }
+               size_t n = (size_t)(digits + 20 - p);
+               ::memcpy(out, p, n);
+               return out + n;
+             }
+
+             inline char * format(int64_t x, char * out){
+               if (x < 0){
+                 *out++ = '-';
+                 return format((uint64_t)0 - (uint64_t)x, out);
+               }
+               return format((uint64_t)x, out);
+             }
+
+             // Significand and binary exponent of a double, v = f * 2^e.
+             struct diy_fp{
+               uint64_t f;
+               int e;
+
+               diy_fp(uint64_t fraction, int exponent) : f(fraction), e(exponent) { }
+
+               explicit diy_fp(double d){
+                 uint64_t bits;
+                 ::memcpy(&bits, &d, sizeof(bits));
+                 int biased = (int)((bits >> 52) & 0x7FF);
+                 f = bits & 0xFFFFFFFFFFFFFULL;
+                 if (biased != 0){
+                   f += 0x10000000000000ULL;
+                   e = biased - 1075;
+                 }else{
+                   e = -1074;
+                 }
+               }
+
+               diy_fp operator-(diy_fp const & o) const { return diy_fp(f - o.f, e); }
+
+               // Upper 64 bits of the product, rounded.
+               diy_fp operator*(diy_fp const & o) const {
+                 const uint64_t mask = 0xFFFFFFFF;
+                 uint64_t a = f >> 32, b = f & mask, c = o.f >> 32, d = o.f & mask;
+                 uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+                 uint64_t mid = (bd >> 32) + (ad & mask) + (bc & mask) + (1ULL << 31);
+                 return diy_fp(ac + (ad >> 32) + (bc >> 32) + (mid >> 32), e + o.e + 64);
+               }
+
+               diy_fp normalize() const {
+                 int s = __builtin_clzll(f);
+                 return diy_fp(f << s, e - s);
+               }
+
+               // Neighbours half way to the next and previous double.
+               void boundaries(diy_fp & minus, diy_fp & plus) const {
+                 plus = diy_fp((f << 1) + 1, e - 1).normalize();
+                 if (f == 0x10000000000000ULL)
+                   minus = diy_fp((f << 2) - 1, e - 2);
+                 else
+                   minus = diy_fp((f << 1) - 1, e - 1);
+                 minus.f <<= minus.e - plus.e;
+                 minus.e = plus.e;
+               }
+             };
+
+             // 10^k for k = -348, -340, ..., 340.
+             inline diy_fp cached_power(int e, int & k){
+               static const uint64_t f[] = {
+                   0xfa8fd5a0081c0288, 0xbaaee17fa23ebf76, 0x8b16fb203055ac76,
+                   0xcf42894a5dce35ea, 0x9a6bb0aa55653b2d, 0xe61acf033d1a45df,
+                   0xab70fe17c79ac6ca, 0xff77b1fcbebcdc4f, 0xbe5691ef416bd60c,
+                   0x8dd01fad907ffc3c, 0xd3515c2831559a83, 0x9d71ac8fada6c9b5,
+                   0xea9c227723ee8bcb, 0xaecc49914078536d, 0x823c12795db6ce57,
+                   0xc21094364dfb5637, 0x9096ea6f3848984f, 0xd77485cb25823ac7,
+                   0xa086cfcd97bf97f4, 0xef340a98172aace5, 0xb23867fb2a35b28e,
+                   0x84c8d4dfd2c63f3b, 0xc5dd44271ad3cdba, 0x936b9fcebb25c996,
+                   0xdbac6c247d62a584, 0xa3ab66580d5fdaf6, 0xf3e2f893dec3f126,
+                   0xb5b5ada8aaff80b8, 0x87625f056c7c4a8b, 0xc9bcff6034c13053,
+                   0x964e858c91ba2655, 0xdff9772470297ebd, 0xa6dfbd9fb8e5b88f,
+                   0xf8a95fcf88747d94, 0xb94470938fa89bcf, 0x8a08f0f8bf0f156b,
+                   0xcdb02555653131b6, 0x993fe2c6d07b7fac, 0xe45c10c42a2b3b06,
+                   0xaa242499697392d3, 0xfd87b5f28300ca0e, 0xbce5086492111aeb,
+                   0x8cbccc096f5088cc, 0xd1b71758e219652c, 0x9c40000000000000,
+                   0xe8d4a51000000000, 0xad78ebc5ac620000, 0x813f3978f8940984,
+                   0xc097ce7bc90715b3, 0x8f7e32ce7bea5c70, 0xd5d238a4abe98068,
+                   0x9f4f2726179a2245, 0xed63a231d4c4fb27, 0xb0de65388cc8ada8,
+                   0x83c7088e1aab65db, 0xc45d1df942711d9a, 0x924d692ca61be758,
+                   0xda01ee641a708dea, 0xa26da3999aef774a, 0xf209787bb47d6b85,
+                   0xb454e4a179dd1877, 0x865b86925b9bc5c2, 0xc83553c5c8965d3d,
+                   0x952ab45cfa97a0b3, 0xde469fbd99a05fe3, 0xa59bc234db398c25,
+                   0xf6c69a72a3989f5c, 0xb7dcbf5354e9bece, 0x88fcf317f22241e2,
+                   0xcc20ce9bd35c78a5, 0x98165af37b2153df, 0xe2a0b5dc971f303a,
+                   0xa8d9d1535ce3b396, 0xfb9b7cd9a4a7443c, 0xbb764c4ca7a44410,
+                   0x8bab8eefb6409c1a, 0xd01fef10a657842c, 0x9b10a4e5e9913129,
+                   0xe7109bfba19c0c9d, 0xac2820d9623bf429, 0x80444b5e7aa7cf85,
+                   0xbf21e44003acdd2d, 0x8e679c2f5e44ff8f, 0xd433179d9c8cb841,
+                   0x9e19db92b4e31ba9, 0xeb96bf6ebadf77d9, 0xaf87023b9bf0ee6b
+               };
+               static const int16_t exponent[] = {
+                   -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+                   -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+                   -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+                   -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+                   56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+                   375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+                   694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+                   1013, 1039, 1066
+               };
+               double dk = (-61 - e) * 0.30102999566398114 + 347;
+               int i = (int)dk;
+               if (dk - i > 0.0)
+                 i++;
+               unsigned index = (unsigned)((i >> 3) + 1);
+               k = -(-348 + (int)(index << 3));
+               return diy_fp(f[index], exponent[index]);
+             }
+
+             inline void round_digit(char * buffer, int length, uint64_t delta, uint64_t rest,
+                                     uint64_t ten_kappa, uint64_t wp_w){
+               while (rest < wp_w && delta - rest >= ten_kappa &&
+                      (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)){
+                 buffer[length - 1]--;
+                 rest += ten_kappa;
+               }
+             }
+
+             inline int count_digits(uint32_t n){
+               int d = 1;
+               while (d < 10 && n >= pow10[d])
+                 d++;
+               return d;
+             }
+
+             inline void generate(diy_fp const & w, diy_fp const & mp, uint64_t delta,
+                                  char * buffer, int & length, int & k){
+               const diy_fp one(1ULL << -mp.e, mp.e);
+               const diy_fp wp_w = mp - w;
+               uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+               uint64_t p2 = mp.f & (one.f - 1);
+               int kappa = count_digits(p1);
+               length = 0;
+
+               while (kappa > 0){
+                 uint32_t d = (uint32_t)(p1 / pow10[kappa - 1]);
+                 p1 = (uint32_t)(p1 % pow10[kappa - 1]);
+                 if (d != 0 || length != 0)
+                   buffer[length++] = (char)('0' + d);
+                 kappa--;
+                 uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+                 if (rest <= delta){
+                   k += kappa;
+                   round_digit(buffer, length, delta, rest, pow10[kappa] << -one.e, wp_w.f);
+                   return;
+                 }
+               }
+
+               for(;;){
+                 p2 *= 10;
+                 delta *= 10;
+                 char d = (char)(p2 >> -one.e);
+                 if (d != 0 || length != 0)
+                   buffer[length++] = (char)('0' + d);
+                 p2 &= one.f - 1;
+                 kappa--;
+                 if (p2 < delta){
+                   k += kappa;
+                   int index = -kappa;
+                   round_digit(buffer, length, delta, p2, one.f,
+                               wp_w.f * (index < 20 ? pow10[index] : 0));
+                   return;
+                 }
+               }
+             }
+
+             // Shortest digits of v > 0, v = digits * 10^k.
+             inline void grisu2(double v, char * buffer, int & length, int & k){
+               diy_fp w(v);
+               diy_fp minus(0, 0), plus(0, 0);
+               w.boundaries(minus, plus);
+               diy_fp c = cached_power(plus.e, k);
+               diy_fp W = w.normalize() * c;
+               diy_fp Wp = plus * c;
+               diy_fp Wm = minus * c;
+               Wm.f++;
+               Wp.f--;
+               generate(W, Wp, Wp.f - Wm.f, buffer, length, k);
+             }
+
+             inline char * exponent(int e, char * out){
+               *out++ = 'e';
+               if (e < 0){
+                 *out++ = '-';
+                 e = -e;
+               }
+               return format((uint64_t)e, out);
+             }
+
+             // Plain notation from 1e-6 up to 1e21, integers without a
+             // fraction, scientific notation outside that.
+             inline char * format_shortest(double v, char * out){
+               if (v != v){
+                 ::memcpy(out, "nan", 3);
+                 return out + 3;
+               }
+               if (::std::signbit(v)){
+                 *out++ = '-';
+                 v = -v;
+               }
+               if (v == 0){
+                 *out++ = '0';
+                 return out;
+               }
+               if (v == HUGE_VAL){
+                 ::memcpy(out, "inf", 3);
+                 return out + 3;
+               }
+
+               char digits[20];
+               int length, k;
+               grisu2(v, digits, length, k);
+               int point = length + k;
+
+               if (k >= 0 && point <= 21){
+                 ::memcpy(out, digits, (size_t)length);
+                 ::memset(out + length, '0', (size_t)k);
+                 return out + point;
+               }
+               if (point > 0 && point <= 21){
+                 ::memcpy(out, digits, (size_t)point);
+                 out[point] = '.';
+                 ::memcpy(out + point + 1, digits + point, (size_t)(length - point));
+                 return out + length + 1;
+               }
+               if (point > -6 && point <= 0){
+                 *out++ = '0';
+                 *out++ = '.';
+                 ::memset(out, '0', (size_t)-point);
+                 out += -point;
+                 ::memcpy(out, digits, (size_t)length);
+                 return out + length;
+               }
+               *out++ = digits[0];
+               if (length > 1){
+                 *out++ = '.';
+                 ::memcpy(out, digits + 1, (size_t)(length - 1));
+                 out += length - 1;
+               }
+               return exponent(point - 1, out);
+             }
+
+             // Same text as printf("%.*f"), exact ties round to even.
+             // Values whose scaled magnitude does not fit 64 bits, and
+             // targets without 128 bit integers, go through snprintf.
+             inline char * format_fixed(double v, int digits, char * out){
+             #if defined(__SIZEOF_INT128__)
+               double magnitude = ::fabs(v);
+               if (digits <= 17 && magnitude < 1e18 / (double)pow10[digits]){
+                 diy_fp x(magnitude);
+                 unsigned __int128 n = (unsigned __int128)x.f * pow10[digits];
+                 uint64_t q;
+                 if (x.e >= 0){
+                   q = (uint64_t)(n << x.e);
+                 }else if (-x.e > 120){
+                   q = 0;
+                 }else{
+                   int s = -x.e;
+                   unsigned __int128 whole = n >> s;
+                   unsigned __int128 rest = n - (whole << s);
+                   unsigned __int128 half = (unsigned __int128)1 << (s - 1);
+                   q = (uint64_t)whole;
+                   if (rest > half || (rest == half && (q & 1) != 0))
+                     q++;
+                 }
+
+                 if (::std::signbit(v))
+                   *out++ = '-';
+                 out = format(q / pow10[digits], out);
+                 if (digits > 0){
+                   *out++ = '.';
+                   uint64_t fraction = q % pow10[digits];
+                   for(int i = digits - 1; i >= 0; i--){
+                     out[i] = (char)('0' + fraction % 10);
+                     fraction /= 10;
+                   }
+                   out += digits;
+                 }
+                 return out;
+               }
+             #endif
+               int n = ::snprintf(out, buffer_size, "%.*f", digits, v);
+               return out + (n < 0 ? 0 : n);
+             }
+
+             inline char * format(double v, int digits, char * out){
+               if (digits < 0)
+                 return format_shortest(v, out);
+               return format_fixed(v, (digits > 17) ? 17 : digits, out);
+             }
+
+             // Reads [+-]digits[.digits][(e|E)[+-]digits] from [b, e),
+             // returns where it stopped, b when there is no number.
+             // Up to 19 significant digits scaled by at most 10^22 are
+             // exact in doubles, anything else goes through strtod.
+             inline const char * parse(const char * b, const char * e, double & out){
+               const char * p = b;
+               bool negative = false;
+               if (p < e && (*p == '-' || *p == '+')){
+                 negative = (*p == '-');
+                 p++;
+               }
+
+               uint64_t mantissa = 0;
+               int digits = 0;
+               int scale = 0;
+               bool any = false;
+               bool exact = true;
+               for(; p < e && *p >= '0' && *p <= '9'; p++){
+                 any = true;
+                 if (digits < 19){
+                   mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                   if (mantissa != 0)
+                     digits++;
+                 }else{
+                   scale++;
+                   exact = false;
+                 }
+               }
+               if (p < e && *p == '.'){
+                 p++;
+                 for(; p < e && *p >= '0' && *p <= '9'; p++){
+                   any = true;
+                   if (digits < 19){
+                     mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                     if (mantissa != 0)
+                       digits++;
+                     scale--;
+                   }else{
+                     exact = false;
+                   }
+                 }
+               }
+               if (!any)
+                 return b;
+
+               if (p < e && (*p == 'e' || *p == 'E')){
+                 const char * q = p + 1;
+                 bool minus = false;
+                 if (q < e && (*q == '-' || *q == '+')){
+                   minus = (*q == '-');
+                   q++;
+                 }
+                 if (q < e && *q >= '0' && *q <= '9'){
+                   int x = 0;
+                   for(; q < e && *q >= '0' && *q <= '9'; q++)
+                     if (x < 100000)
+                       x = x * 10 + (*q - '0');
+                   scale += minus ? -x : x;
+                   p = q;
+                 }
+               }
+
+               if (exact && mantissa <= (1ULL << 53) && scale >= -22 && scale <= 22){
+                 double d = (double)mantissa;
+                 if (scale < 0)
+                   d /= exact_pow10[-scale];
+                 else
+                   d *= exact_pow10[scale];
+                 out = negative ? -d : d;
+                 return p;
+               }
+
+               ::std::string text(b, p);
+               out = ::strtod(text.c_str(), nullptr);
+               return p;
+             }
+           }
+
+           namespace runtime{
+             // Decimals printed for numbers from now on, decimal::shortest
+             // for the shortest text that reads back the same.
+             inline void set_number_precision(int digits){
+               decimal::precision().store(digits);
+             }
+           }
+         }
+         #endif
+
          // Initialize Hardware
          namespace ferret{
            #if !defined(FERRET_UART_RATE)
@@ -386,7 +860,9 @@
            
                template <>
                void print(const real_t n){
-                 std::cout << std::fixed << std::setprecision(number_precision) << n;
+                 char buffer[decimal::buffer_size];
+                 char * end = decimal::format((double)n, decimal::precision().load(::std::memory_order_relaxed), buffer);
+                 std::cout.write(buffer, end - buffer);
                }
            
                void read_line(char *buff, std::streamsize len){
@@ -427,6 +903,594 @@
            #endif
          }
 
+         // Tracing
+         #if defined(FERRET_ENABLE_TRACE)
+          #include <typeinfo>
+          #include <cxxabi.h>
+          #if defined(__x86_64__) || defined(__i386__)
+           #include <x86intrin.h>
+          #endif
+
+          #define FERRET_TRACE_SCOPE(fn)       ::ferret::trace::scope _trace_scope_(fn, ::ferret::trace::call)
+          #define FERRET_TRACE_ASYNC_SCOPE(fn) ::ferret::trace::scope _trace_scope_(fn, ::ferret::trace::task)
+         #else
+          #define FERRET_TRACE_SCOPE(fn)
+          #define FERRET_TRACE_ASYNC_SCOPE(fn)
+         #endif
+
+         #if defined(FERRET_ENABLE_TRACE)
+         namespace ferret{
+           #if !defined(FERRET_TRACE_BUFFER_SIZE)
+             # define FERRET_TRACE_BUFFER_SIZE 65536
+           #endif
+           #if !defined(FERRET_TRACE_STACK_DEPTH)
+             # define FERRET_TRACE_STACK_DEPTH 256
+           #endif
+           #if !defined(FERRET_TRACE_FUNCTIONS)
+             # define FERRET_TRACE_FUNCTIONS 1024
+           #endif
+           #if !defined(FERRET_TRACE_FILE)
+             # define FERRET_TRACE_FILE "trace.json"
+           #endif
+
+           namespace trace{
+             enum category : char { call = 'c', task = 'a' };
+
+             // TSC ticks where available, otherwise the elapsed_micros clock.
+             inline uint64_t now(){
+           #if defined(__x86_64__) || defined(__i386__)
+               return __rdtsc();
+           #else
+               auto epoch = ::std::chrono::high_resolution_clock::now().time_since_epoch();
+               return (uint64_t)::std::chrono::duration_cast<::std::chrono::microseconds>(epoch).count();
+           #endif
+             }
+
+             inline uint64_t micros(){
+               auto epoch = ::std::chrono::steady_clock::now().time_since_epoch();
+               return (uint64_t)::std::chrono::duration_cast<::std::chrono::microseconds>(epoch).count();
+             }
+
+             struct event{
+               const ::std::type_info * fn;
+               uint64_t ts;
+               char phase;
+               char cat;
+             };
+
+             // An event as it sits in the ring, dump reads slots while the
+             // owning thread may be overwriting them.
+             struct slot{
+               ::std::atomic<const ::std::type_info *> fn;
+               ::std::atomic<uint64_t> ts;
+               ::std::atomic<char> phase;
+               ::std::atomic<char> cat;
+             };
+
+             struct frame{
+               const ::std::type_info * fn;
+               uint64_t begin;
+               uint64_t child;
+               char cat;
+             };
+
+             struct stats{
+               const ::std::type_info * fn;
+               uint64_t calls;
+               uint64_t inclusive;
+               uint64_t exclusive;
+             };
+
+             struct counter{
+               ::std::atomic<const ::std::type_info *> fn;
+               ::std::atomic<uint64_t> calls;
+               ::std::atomic<uint64_t> inclusive;
+               ::std::atomic<uint64_t> exclusive;
+             };
+
+             template<typename T>
+             inline void bump(::std::atomic<T> & x, T n){
+               x.store(x.load(::std::memory_order_relaxed) + n, ::std::memory_order_relaxed);
+             }
+
+             // Ring written by one thread without locks. head counts every
+             // event ever written, older ones are overwritten in place.
+             // claim is moved past a slot before it is rewritten so a copy
+             // taken concurrently can tell which of its slots were
+             // overwritten under it. The call stack is private to the
+             // thread.
+             class buffer{
+             public:
+               slot events[FERRET_TRACE_BUFFER_SIZE];
+               ::std::atomic<size_t> head;
+               ::std::atomic<size_t> claim;
+               frame stack[FERRET_TRACE_STACK_DEPTH];
+               size_t depth;
+               counter table[FERRET_TRACE_FUNCTIONS];
+               ::std::atomic<uint64_t> dropped;
+               size_t tid;
+
+               buffer() : head(0), claim(0), depth(0), table(), dropped(0), tid(0) { }
+
+               inline void record(const ::std::type_info * fn, uint64_t ts, char phase, char cat){
+                 size_t h = head.load(::std::memory_order_relaxed);
+                 claim.store(h + 1, ::std::memory_order_relaxed);
+                 ::std::atomic_thread_fence(::std::memory_order_release);
+                 slot & e = events[h % FERRET_TRACE_BUFFER_SIZE];
+                 e.fn.store(fn, ::std::memory_order_relaxed);
+                 e.ts.store(ts, ::std::memory_order_relaxed);
+                 e.phase.store(phase, ::std::memory_order_relaxed);
+                 e.cat.store(cat, ::std::memory_order_relaxed);
+                 head.store(h + 1, ::std::memory_order_release);
+               }
+
+               // Null once the table is full, those calls are only counted
+               // as dropped.
+               inline counter * lookup(const ::std::type_info * fn){
+                 size_t i = (((uintptr_t)fn) >> 4) % FERRET_TRACE_FUNCTIONS;
+                 for(size_t n = 0; n < FERRET_TRACE_FUNCTIONS; n++){
+                   counter & s = table[(i + n) % FERRET_TRACE_FUNCTIONS];
+                   const ::std::type_info * owner = s.fn.load(::std::memory_order_relaxed);
+                   if (owner == fn)
+                     return &s;
+                   if (owner == nullptr){
+                     s.fn.store(fn, ::std::memory_order_release);
+                     return &s;
+                   }
+                 }
+                 return nullptr;
+               }
+
+               inline void enter(const ::std::type_info * fn, char cat){
+                 uint64_t ts = now();
+                 if (depth < FERRET_TRACE_STACK_DEPTH){
+                   frame & f = stack[depth];
+                   f.fn = fn;
+                   f.begin = ts;
+                   f.child = 0;
+                   f.cat = cat;
+                   record(fn, ts, 'B', cat);
+                 }
+                 depth++;
+               }
+
+               // A call that is only suspended is not counted yet, its
+               // time so far is.
+               inline void leave(bool completed = true){
+                 uint64_t ts = now();
+                 depth--;
+                 if (depth < FERRET_TRACE_STACK_DEPTH){
+                   frame & f = stack[depth];
+                   uint64_t elapsed = ts - f.begin;
+                   if (depth > 0)
+                     stack[depth - 1].child += elapsed;
+                   counter * s = lookup(f.fn);
+                   if (s == nullptr){
+                     bump<uint64_t>(dropped, completed);
+                   }else{
+                     bump<uint64_t>(s->calls, completed);
+                     bump<uint64_t>(s->inclusive, elapsed);
+                     bump<uint64_t>(s->exclusive, elapsed - f.child);
+                   }
+                   record(f.fn, ts, 'E', f.cat);
+                 }
+               }
+
+               // Closes the scopes above base when a green task parks, the
+               // task keeps them in saved and reopens them with resume on
+               // whichever thread runs it next.
+               void suspend(size_t base, ::std::vector<frame> & saved){
+                 bool outer = (base > 0 && base <= FERRET_TRACE_STACK_DEPTH);
+                 uint64_t child = outer ? stack[base - 1].child : 0;
+                 saved.resize(depth - base);
+                 while (depth > base){
+                   size_t i = depth - 1;
+                   frame & f = saved[i - base];
+                   if (i < FERRET_TRACE_STACK_DEPTH)
+                     f = stack[i];
+                   else
+                     f.fn = nullptr;
+                   leave(false);
+                 }
+                 // The thread's own scopes are not charged for the task.
+                 if (outer)
+                   stack[base - 1].child = child;
+               }
+
+               void resume(::std::vector<frame> const & saved){
+                 for(auto const & f : saved){
+                   if (f.fn == nullptr)
+                     depth++;
+                   else
+                     enter(f.fn, f.cat);
+                 }
+               }
+
+               // Safe against the owning thread still writing, slots it
+               // rewrote while they were being copied are left out.
+               void copy(::std::vector<event> & out, ::std::vector<stats> & totals, uint64_t & lost) const {
+                 size_t end = head.load(::std::memory_order_acquire);
+                 size_t begin = (end > FERRET_TRACE_BUFFER_SIZE) ? (end - FERRET_TRACE_BUFFER_SIZE) : 0;
+                 size_t first = out.size();
+                 for(size_t i = begin; i < end; i++){
+                   slot const & e = events[i % FERRET_TRACE_BUFFER_SIZE];
+                   out.push_back(event{e.fn.load(::std::memory_order_relaxed),
+                                       e.ts.load(::std::memory_order_relaxed),
+                                       e.phase.load(::std::memory_order_relaxed),
+                                       e.cat.load(::std::memory_order_relaxed)});
+                 }
+                 ::std::atomic_thread_fence(::std::memory_order_acquire);
+                 size_t claimed = claim.load(::std::memory_order_relaxed);
+                 if (claimed > begin + FERRET_TRACE_BUFFER_SIZE){
+                   size_t stale = ::std::min(claimed - FERRET_TRACE_BUFFER_SIZE - begin, end - begin);
+                   out.erase(out.begin() + (ptrdiff_t)first, out.begin() + (ptrdiff_t)(first + stale));
+                 }
+                 for(auto const & s : table){
+                   const ::std::type_info * fn = s.fn.load(::std::memory_order_acquire);
+                   if (fn != nullptr)
+                     totals.push_back(stats{fn,
+                                            s.calls.load(::std::memory_order_relaxed),
+                                            s.inclusive.load(::std::memory_order_relaxed),
+                                            s.exclusive.load(::std::memory_order_relaxed)});
+                 }
+                 lost += dropped.load(::std::memory_order_relaxed);
+               }
+
+               void reset(){
+                 head.store(0, ::std::memory_order_relaxed);
+                 claim.store(0, ::std::memory_order_relaxed);
+                 depth = 0;
+                 for(auto & s : table){
+                   s.fn.store(nullptr, ::std::memory_order_relaxed);
+                   s.calls.store(0, ::std::memory_order_relaxed);
+                   s.inclusive.store(0, ::std::memory_order_relaxed);
+                   s.exclusive.store(0, ::std::memory_order_relaxed);
+                 }
+                 dropped.store(0, ::std::memory_order_relaxed);
+               }
+             };
+
+             // Every thread gets its own lane in the dump. A thread that
+             // exits leaves a copy of its events and totals behind and its
+             // buffer is handed to the next thread that starts.
+             class registry{
+               ::std::mutex lock;
+               ::std::vector<buffer*> buffers;
+               ::std::vector<buffer*> spare;
+               ::std::vector<::std::pair<size_t, ::std::vector<event>>> exited;
+               ::std::vector<stats> totals;
+               uint64_t dropped;
+               size_t lanes;
+             public:
+               const uint64_t tsc_epoch;
+               const uint64_t us_epoch;
+
+               registry() : dropped(0), lanes(0), tsc_epoch(now()), us_epoch(micros()) { }
+
+               buffer * attach(){
+                 ::std::lock_guard<::std::mutex> guard(lock);
+                 buffer * b;
+                 if (spare.empty()){
+                   b = new buffer();
+                 }else{
+                   b = spare.back();
+                   spare.pop_back();
+                 }
+                 b->tid = lanes++;
+                 buffers.push_back(b);
+                 return b;
+               }
+
+               void detach(buffer * b){
+                 ::std::vector<event> events;
+                 ::std::lock_guard<::std::mutex> guard(lock);
+                 b->copy(events, totals, dropped);
+                 if (!events.empty())
+                   exited.emplace_back(b->tid, ::std::move(events));
+                 b->reset();
+                 buffers.erase(::std::find(buffers.begin(), buffers.end(), b));
+                 spare.push_back(b);
+               }
+
+               // Lanes in the order their threads started, events of each.
+               void collect(::std::vector<::std::pair<size_t, ::std::vector<event>>> & lanes_out,
+                            ::std::vector<stats> & table, uint64_t & lost){
+                 ::std::lock_guard<::std::mutex> guard(lock);
+                 lanes_out = exited;
+                 for(auto b : buffers){
+                   lanes_out.emplace_back(b->tid, ::std::vector<event>());
+                   b->copy(lanes_out.back().second, table, lost);
+                 }
+                 table.insert(table.end(), totals.begin(), totals.end());
+                 lost += dropped;
+                 ::std::sort(lanes_out.begin(), lanes_out.end(),
+                             [](::std::pair<size_t, ::std::vector<event>> const & a,
+                                ::std::pair<size_t, ::std::vector<event>> const & b){
+                               return a.first < b.first;
+                             });
+               }
+             };
+
+             // Never destroyed, detached threads may still exit after
+             // static destructors have run.
+             registry & threads(){
+               static registry * r = new registry();
+               return *r;
+             }
+
+             class lane{
+             public:
+               buffer * const b;
+               lane() : b(threads().attach()) { }
+               ~lane() { threads().detach(b); }
+             };
+
+             inline buffer & local(){
+               static thread_local lane l;
+               return *l.b;
+             }
+
+             // The buffer is looked up again on exit, a green task may have
+             // parked and resumed on another thread in between.
+             class scope{
+             public:
+               explicit scope(const scope &) = delete;
+               explicit scope(const ::std::type_info & fn, char cat) { local().enter(&fn, cat); }
+               ~scope() { local().leave(); }
+             };
+
+             ::std::string name(const ::std::type_info * fn){
+               int status = 0;
+               char * demangled = abi::__cxa_demangle(fn->name(), nullptr, nullptr, &status);
+               ::std::string ret(status == 0 ? demangled : fn->name());
+               ::free(demangled);
+               return ret;
+             }
+
+             // Chrome trace event format, per function totals go under
+             // ferretProfile which the trace viewer ignores.
+             void dump(const char * file = FERRET_TRACE_FILE){
+               registry & r = threads();
+               double ticks_per_us = 1;
+           #if defined(__x86_64__) || defined(__i386__)
+               uint64_t us = micros() - r.us_epoch;
+               if (us > 0)
+                 ticks_per_us = (double)(now() - r.tsc_epoch) / (double)us;
+           #endif
+               ::std::vector<::std::pair<size_t, ::std::vector<event>>> lanes;
+               ::std::vector<stats> table;
+               uint64_t dropped = 0;
+               r.collect(lanes, table, dropped);
+               ::std::FILE * out = ::std::fopen(file, "w");
+               if (out == nullptr)
+                 return;
+
+               ::std::fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+               bool comma = false;
+               for(auto const & lane : lanes){
+                 size_t tid = lane.first;
+                 ::std::fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,"
+                                "\"args\":{\"name\":\"ferret-%zu\"}}", (comma ? "," : ""), tid, tid);
+                 comma = true;
+                 for(auto const & e : lane.second)
+                   ::std::fprintf(out, ",{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f}",
+                                  name(e.fn).c_str(), (e.cat == task ? "async" : "call"), e.phase, tid,
+                                  (double)(e.ts - r.tsc_epoch) / ticks_per_us);
+               }
+
+               ::std::fprintf(out, "],\"ferretDroppedCalls\":%llu,\"ferretProfile\":[",
+                              (unsigned long long)dropped);
+               ::std::vector<stats> totals;
+               for(auto const & s : table){
+                 auto it = ::std::find_if(totals.begin(), totals.end(),
+                                          [&s](stats const & t){ return *t.fn == *s.fn; });
+                 if (it == totals.end()){
+                   totals.push_back(s);
+                 }else{
+                   it->calls += s.calls;
+                   it->inclusive += s.inclusive;
+                   it->exclusive += s.exclusive;
+                 }
+               }
+               for(size_t i = 0; i < totals.size(); i++)
+                 ::std::fprintf(out, "%s{\"name\":\"%s\",\"calls\":%llu,\"inclusive_us\":%.3f,\"exclusive_us\":%.3f}",
+                                (i == 0 ? "" : ","), name(totals[i].fn).c_str(),
+                                (unsigned long long)totals[i].calls,
+                                (double)totals[i].inclusive / ticks_per_us,
+                                (double)totals[i].exclusive / ticks_per_us);
+               ::std::fprintf(out, "]}\n");
+               ::std::fclose(out);
+             }
+           }
+         }
+         #endif
+
+         // Text Search
+         #if defined(FERRET_STD_LIB) && defined(__GNUC__) && !defined(FERRET_DISABLE_SIMD)
+          #if defined(__AVX2__)
+           #include <immintrin.h>
+           #define FERRET_SIMD_AVX2
+          #elif defined(__SSE2__)
+           #include <emmintrin.h>
+           #define FERRET_SIMD_SSE2
+          #endif
+         #endif
+
+         #if defined(FERRET_STD_LIB)
+         namespace ferret{
+           // Byte level kernels over contiguous text, a block of characters
+           // is tested per step where the target has vector registers.
+           namespace simd{
+           #if defined(FERRET_SIMD_AVX2)
+             #define FERRET_SIMD
+             typedef __m256i block;
+             const size_t width = 32;
+             const uint32_t all = 0xFFFFFFFF;
+
+             inline block load(const char * p){ return _mm256_loadu_si256((const __m256i *)p); }
+             inline block splat(char c){ return _mm256_set1_epi8(c); }
+             inline uint32_t high_bits(block b){ return (uint32_t)_mm256_movemask_epi8(b); }
+             inline uint32_t equal(block a, block b){ return high_bits(_mm256_cmpeq_epi8(a, b)); }
+           #elif defined(FERRET_SIMD_SSE2)
+             #define FERRET_SIMD
+             typedef __m128i block;
+             const size_t width = 16;
+             const uint32_t all = 0xFFFF;
+
+             inline block load(const char * p){ return _mm_loadu_si128((const __m128i *)p); }
+             inline block splat(char c){ return _mm_set1_epi8(c); }
+             inline uint32_t high_bits(block b){ return (uint32_t)_mm_movemask_epi8(b); }
+             inline uint32_t equal(block a, block b){ return high_bits(_mm_cmpeq_epi8(a, b)); }
+           #endif
+           }
+
+           namespace text{
+             const size_t npos = (size_t)-1;
+
+             // Length of the well formed UTF-8 sequence at s, 0 if there is
+             // none. Overlong forms, surrogates and code points past
+             // U+10FFFF are rejected.
+             inline size_t utf8_sequence(const unsigned char * s, size_t n){
+               unsigned char c = s[0];
+               if (c < 0x80)
+                 return 1;
+               if (c < 0xC2)
+                 return 0;
+               if (c < 0xE0)
+                 return (n >= 2 && (s[1] & 0xC0) == 0x80) ? 2 : 0;
+               if (c < 0xF0){
+                 if (n < 3 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80)
+                   return 0;
+                 if ((c == 0xE0 && s[1] < 0xA0) || (c == 0xED && s[1] > 0x9F))
+                   return 0;
+                 return 3;
+               }
+               if (c < 0xF5){
+                 if (n < 4 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80 ||
+                     (s[3] & 0xC0) != 0x80)
+                   return 0;
+                 if ((c == 0xF0 && s[1] < 0x90) || (c == 0xF4 && s[1] > 0x8F))
+                   return 0;
+                 return 4;
+               }
+               return 0;
+             }
+
+             // Blocks of ASCII are skipped whole, a block holding any other
+             // byte is decoded sequence by sequence.
+             inline bool is_utf8(const char * s, size_t n){
+               const unsigned char * u = (const unsigned char *)s;
+               size_t i = 0;
+           #if defined(FERRET_SIMD)
+               while (i + simd::width <= n){
+                 if (simd::high_bits(simd::load(s + i)) == 0){
+                   i += simd::width;
+                   continue;
+                 }
+                 size_t end = i + simd::width;
+                 while (i < end){
+                   size_t k = utf8_sequence(u + i, n - i);
+                   if (k == 0)
+                     return false;
+                   i += k;
+                 }
+               }
+           #endif
+               while (i < n){
+                 size_t k = utf8_sequence(u + i, n - i);
+                 if (k == 0)
+                   return false;
+                 i += k;
+               }
+               return true;
+             }
+
+             inline size_t find(const char * s, size_t n, char c){
+           #if defined(FERRET_SIMD)
+               size_t i = 0;
+               simd::block needle = simd::splat(c);
+               for(; i + simd::width <= n; i += simd::width){
+                 uint32_t m = simd::equal(simd::load(s + i), needle);
+                 if (m != 0)
+                   return i + (size_t)__builtin_ctz(m);
+               }
+               for(; i < n; i++)
+                 if (s[i] == c)
+                   return i;
+               return npos;
+           #else
+               const char * p = (const char *)::memchr(s, c, n);
+               return (p == nullptr) ? npos : (size_t)(p - s);
+           #endif
+             }
+
+             // Candidates are positions where both the first and the last
+             // character of w match, only those are compared in full.
+             inline size_t find(const char * s, size_t n, const char * w, size_t m){
+               if (m == 0)
+                 return 0;
+               if (m > n)
+                 return npos;
+               if (m == 1)
+                 return find(s, n, w[0]);
+
+               size_t last = n - m;
+               size_t i = 0;
+           #if defined(FERRET_SIMD)
+               simd::block head = simd::splat(w[0]);
+               simd::block tail = simd::splat(w[m - 1]);
+               for(; i + simd::width <= last + 1; i += simd::width){
+                 uint32_t c = (simd::equal(simd::load(s + i), head) &
+                               simd::equal(simd::load(s + i + m - 1), tail));
+                 for(; c != 0; c &= c - 1){
+                   size_t k = i + (size_t)__builtin_ctz(c);
+                   if (::memcmp(s + k + 1, w + 1, m - 2) == 0)
+                     return k;
+                 }
+               }
+           #endif
+               for(; i <= last; i++){
+                 const char * p = (const char *)::memchr(s + i, w[0], last - i + 1);
+                 if (p == nullptr)
+                   return npos;
+                 i = (size_t)(p - s);
+                 if (::memcmp(p + 1, w + 1, m - 1) == 0)
+                   return i;
+               }
+               return npos;
+             }
+
+             // Index of the first byte where a and b differ, n if none.
+             inline size_t mismatch(const char * a, const char * b, size_t n){
+               size_t i = 0;
+           #if defined(FERRET_SIMD)
+               for(; i + simd::width <= n; i += simd::width){
+                 uint32_t m = simd::equal(simd::load(a + i), simd::load(b + i)) ^ simd::all;
+                 if (m != 0)
+                   return i + (size_t)__builtin_ctz(m);
+               }
+           #endif
+               while (i < n && a[i] == b[i])
+                 i++;
+               return i;
+             }
+
+             inline bool starts_with(const char * s, size_t n, const char * p, size_t m){
+               return (m <= n && mismatch(s, p, m) == m);
+             }
+
+             // Byte order, which for UTF-8 is code point order.
+             inline int compare(const char * a, size_t n, const char * b, size_t m){
+               size_t k = (n < m) ? n : m;
+               size_t i = mismatch(a, b, k);
+               if (i < k)
+                 return ((unsigned char)a[i] < (unsigned char)b[i]) ? -1 : 1;
+               return (n < m) ? -1 : ((n > m) ? 1 : 0);
+             }
+           }
+         }
+         #endif
+
          // Object System Base
          namespace ferret{
            namespace memory{
@@ -659,6 +1723,7 @@
            
                  inline void inc_ref() { }
                  inline bool dec_ref() { return false; }
+                 inline bool is_unique() const { return false; }
                };
            
            #else
@@ -670,6 +1735,7 @@
            
                  inline void inc_ref() { ref_count++; }
                  inline bool dec_ref() { return (--ref_count == 0); }
+                 inline bool is_unique() const { return (ref_count == 1); }
                
                private:
                  T ref_count;
@@ -688,22 +1754,112 @@
            #endif
            class var;
            class seekable_i;
+           class reducer_i;
            
-           template <typename rc>
-           class object_i : public rc{
+           // Lazily computed hash of an immutable object. Zero means not
+           // computed yet, a hash that happens to be zero is not cached.
+           class hash_cache{
+           #if defined(FERRET_STD_LIB)
+             mutable ::std::atomic<size_t> code;
+           #else
+             mutable size_t code;
+           #endif
            public:
-             object_i() { }
-             virtual ~object_i() { };
-             
-             virtual size_t type() const = 0;
-             
-           #if !defined(FERRET_DISABLE_STD_OUT)
-             virtual void stream_console() const = 0;
+             hash_cache() : code(0) { }
+
+             inline bool get(size_t & h) const {
+           #if defined(FERRET_STD_LIB)
+               h = code.load(::std::memory_order_relaxed);
+           #else
+               h = code;
+           #endif
+               return (h != 0);
+             }
+
+             inline void set(size_t h) const {
+           #if defined(FERRET_STD_LIB)
+               code.store(h, ::std::memory_order_relaxed);
+           #else
+               code = h;
+           #endif
+             }
+
+             inline void reset() { set(0); }
+           };
+
+           // Hash cache of a collection that also records whether every
+           // element hashes exactly, only then do two cached hashes that
+           // differ prove the collections differ. The flag is stored
+           // before the code, a reader that sees the code but a stale
+           // flag takes the hash as inexact.
+           class exact_hash_cache : public hash_cache{
+           #if defined(FERRET_STD_LIB)
+             mutable ::std::atomic<bool> exact;
+           #else
+             mutable bool exact;
+           #endif
+           public:
+             exact_hash_cache() : exact(false) { }
+
+             inline bool is_exact() const {
+           #if defined(FERRET_STD_LIB)
+               return exact.load(::std::memory_order_relaxed);
+           #else
+               return exact;
+           #endif
+             }
+
+             inline void set(size_t h, bool e) const {
+           #if defined(FERRET_STD_LIB)
+               exact.store(e, ::std::memory_order_relaxed);
+           #else
+               exact = e;
+           #endif
+               hash_cache::set(h);
+             }
+
+             inline bool differs(exact_hash_cache const & o) const {
+               size_t mine, theirs;
+               return (get(mine) && o.get(theirs) && mine != theirs &&
+                       is_exact() && o.is_exact());
+             }
+
+             inline void reset() { set(0, false); }
+           };
+
+           template <typename rc>
+           class object_i : public rc{
+           public:
+             object_i() { }
+             virtual ~object_i() { };
+             
+             virtual size_t type() const = 0;
+             
+           #if !defined(FERRET_DISABLE_STD_OUT)
+             virtual void stream_console() const = 0;
            #endif
              
              virtual bool equals(var const & o) const = 0;
+
+             // Objects that are equal must hash the same, identity like
+             // the default equals.
+             virtual size_t hash() const { return (size_t)this; }
+
+             // True when any object equal to this one hashes the same,
+             // so a hash that differs proves inequality. Numbers near
+             // the edge of their hash cell are not exact.
+             virtual bool hash_exact() const { return false; }
            
              virtual seekable_i* cast_seekable_i() { return nullptr; }
+
+             // Collections that can drive a reduction themselves instead
+             // of being walked through first/rest say so and override reduce.
+             virtual bool reducible() const { return false; }
+
+             virtual bool reduce(reducer_i & , var & ) const { return true; }
+
+             // Collections that know their length without walking it.
+             virtual bool counted(size_t & ) const { return false; }
            
              void* operator new(size_t, void* ptr){ return ptr; }
              void  operator delete(void * ptr){ FERRET_ALLOCATOR::free(ptr); }
@@ -764,6 +1920,16 @@
              }
            
              inline bool is_nil() const { return (obj == nullptr); }
+
+             // True when this var is the only reference to its object, which
+             // may then be updated in place instead of copied.
+             inline bool is_unique() const {
+           #if !defined(FERRET_DISABLE_RC)
+               return (obj != nullptr && obj->is_unique());
+           #else
+               return false;
+           #endif
+             }
            
            private:
              inline void inc_ref(){
@@ -813,10 +1979,16 @@
              var first(var const & coll);
              var rest(var const & coll);
              var cons(var const & x, var const & seq);
+             var make_cell(var const & x, var const & tail);
              var nth(var const & seq, number_t index);
              var nthrest(var const & seq, number_t index);
              size_t count(var const & seq);
              bool is_seqable(var const & seq);
+             bool reduce(reducer_i & rf, var & acc, var const & coll);
+             var reduce(var const & f, var const & init, var const & coll);
+             size_t hash(var const & v);
+             size_t hash_ordered(var const & seq);
+             inline var apply(var const & fn, var const & args);
            }
            template<typename T, typename... Args>
            inline var run(T const & fn, Args const & ... args);
@@ -856,6 +2028,18 @@
                  virtual var rest() const = 0;
                };
                #endif
+         #ifndef FERRET_OBJECT_REDUCIBLE_I
+               #define FERRET_OBJECT_REDUCIBLE_I
+
+               // Receives the elements of a reduction one at a time, returning
+               // false from step stops it early.
+               class reducer_i {
+               public:
+
+                 virtual bool step(var & acc, var const & x) = 0;
+                 virtual void complete(var & ) { }
+               };
+               #endif
          #ifndef FERRET_OBJECT_LAMBDA_I
                #define FERRET_OBJECT_LAMBDA_I
                  namespace runtime {
@@ -904,6 +2088,10 @@
                    return (value == o.cast<boolean>()->container());
                  }
 
+                 size_t hash() const final { return value ? 1231 : 1237; }
+
+                 bool hash_exact() const final { return true; }
+
                #if !defined(FERRET_DISABLE_STD_OUT)
                  void stream_console() const final {
                    if (value)
@@ -949,6 +2137,24 @@
                  else
                    return get()->equals(other);
                }
+
+               namespace runtime {
+                 inline size_t hash(var const & v) {
+                   return v.is_nil() ? 0 : v.get()->hash();
+                 }
+
+                 inline bool hash_exact(var const & v) {
+                   return v.is_nil() || v.get()->hash_exact();
+                 }
+
+                 // Spreads small integers over the word for hashed tries.
+                 inline size_t hash_mix(size_t h) {
+                   h ^= h >> 16;
+                   h *= (size_t)0x45d9f3bU;
+                   h ^= h >> 16;
+                   return h;
+                 }
+               }
                #endif
          #ifndef FERRET_OBJECT_POINTER
                #define FERRET_OBJECT_POINTER
@@ -1041,7 +2247,7 @@
                       const size_t number = 3954;}}
 
                class number final : public object {
-                 const real_t _word;
+                 real_t _word;
                public:
 
 
@@ -1054,6 +2260,64 @@
                      return false;
                  }
 
+                 // Numbers hash to cells four epsilon wide, centred on
+                 // the integers. Equal numbers are less than epsilon
+                 // apart so they fall in the same cell or, for numbers
+                 // within epsilon of an edge, the neighbouring one.
+                 // Lookups that miss probe that cell as well, see near.
+                 // Infinities and values past the range of long long are
+                 // never within epsilon of a different value, their bits
+                 // are hashed instead.
+                 static bool cell_of(real_t x, long long & c, real_t & frac){
+                   real_t w = real_epsilon * 4;
+                   if (!(w > (real_t)0))
+                     return false;
+                   real_t q = x / w + (real_t)0.5;
+                   if (!(q < (real_t)9.2e18 && q > (real_t)-9.2e18))
+                     return false;
+                   c = (long long)q;
+                   if ((real_t)c > q)
+                     c--;
+                   frac = q - (real_t)c;
+                   return true;
+                 }
+
+                 static size_t hash_of(real_t x){
+                   if (x != x)
+                     return 0;
+                   long long c;
+                   real_t frac;
+                   if (!cell_of(x, c, frac)){
+                     uint64_t bits = 0;
+                     __builtin_memcpy(&bits, &x, (sizeof(x) < sizeof(bits)) ? sizeof(x) : sizeof(bits));
+                     return runtime::hash_mix((size_t)bits);
+                   }
+                   return runtime::hash_mix((size_t)c);
+                 }
+
+                 // Hash of the neighbouring cell an equal number may sit
+                 // in, false when x is far enough from both edges.
+                 static bool near(real_t x, size_t & h){
+                   long long c;
+                   real_t frac;
+                   if (x != x || !cell_of(x, c, frac))
+                     return false;
+                   if (frac < (real_t)0.3)
+                     h = runtime::hash_mix((size_t)(c - 1));
+                   else if (frac > (real_t)0.7)
+                     h = runtime::hash_mix((size_t)(c + 1));
+                   else
+                     return false;
+                   return true;
+                 }
+
+                 size_t hash() const final { return hash_of(_word); }
+
+                 bool hash_exact() const final {
+                   size_t h;
+                   return !near(_word, h);
+                 }
+
                #if !defined(FERRET_DISABLE_STD_OUT)
                  void stream_console() const final {
                    runtime::print(_word);
@@ -1094,11 +2358,47 @@
                  var is_bigger_equal(var const & v) const {
                    return obj<boolean>(_word >= v.cast<number>()->word());
                  }
+
+                 // Reuse the left operand when the caller gives up the only
+                 // reference to it.
+                 static var add(var && u, var const & v){
+                   if (!u.is_unique())
+                     return u.cast<number>()->add(v);
+                   u.cast<number>()->_word += v.cast<number>()->word();
+                   return static_cast<var&&>(u);
+                 }
+                 static var sub(var && u, var const & v){
+                   if (!u.is_unique())
+                     return u.cast<number>()->sub(v);
+                   u.cast<number>()->_word -= v.cast<number>()->word();
+                   return static_cast<var&&>(u);
+                 }
+                 static var mul(var && u, var const & v){
+                   if (!u.is_unique())
+                     return u.cast<number>()->mul(v);
+                   u.cast<number>()->_word *= v.cast<number>()->word();
+                   return static_cast<var&&>(u);
+                 }
+                 static var div(var && u, var const & v){
+                   if (!u.is_unique())
+                     return u.cast<number>()->div(v);
+                   u.cast<number>()->_word /= v.cast<number>()->word();
+                   return static_cast<var&&>(u);
+                 }
                  
                  template<typename T> static T to(var const & v){
                    return (T)v.cast<number>()->word();
                  }
                };
+
+               namespace runtime {
+                 // Second hash an equal key may be stored under.
+                 inline bool hash_near(var const & k, size_t & h){
+                   if (k.is_nil() || !k.is_type(type::number))
+                     return false;
+                   return number::near(k.cast<number>()->word(), h);
+                 }
+               }
                #endif
          #ifndef FERRET_OBJECT_EMPTY_SEQUENCE
                #define FERRET_OBJECT_EMPTY_SEQUENCE
@@ -1115,6 +2415,8 @@
                    return true;
                  }
 
+                 size_t hash() const final { return 1; }
+
                #if !defined(FERRET_DISABLE_STD_OUT)
                  void stream_console() const final {
                    runtime::print("()");
@@ -1127,10 +2429,20 @@
                }
 
                namespace runtime {
+                 // Counted collections of size zero start iteration as the
+                 // empty sequence, their first() is nil and would be
+                 // yielded as an element otherwise.
+                 inline var range_start(var const & v){
+                   size_t n = 0;
+                   if (!v.is_nil() && v.get()->counted(n) && n == 0)
+                     return cached::empty_sequence;
+                   return v;
+                 }
+
                  struct range{
                    var p;
 
-                   explicit range(var const & v) : p(v) { }
+                   explicit range(var const & v) : p(range_start(v)) { }
                    inline range begin() const { return range(p); }
                    inline range end()   const { return range(cached::empty_sequence); }
 
@@ -1161,7 +2473,7 @@
                    var p;
                    number_t index;
 
-                   explicit range_indexed(var const & v) : p(v) , index(0) { }
+                   explicit range_indexed(var const & v) : p(range_start(v)) , index(0) { }
                    inline range_indexed begin() const { return range_indexed(p); }
                    inline range_indexed end()   const { return range_indexed(cached::empty_sequence); }
 
@@ -1193,7 +2505,8 @@
                    var first;
                    var second;
 
-                   explicit range_pair(var const & a = nil(), var const & b = nil()) : first(a) , second(b) { }
+                   explicit range_pair(var const & a = nil(), var const & b = nil()) :
+                     first(range_start(a)) , second(range_start(b)) { }
                    
                    inline range_pair begin() const { return range_pair(first, second); }
                    inline range_pair end()   const { return range_pair(cached::empty_sequence,cached::empty_sequence); }
@@ -1214,15 +2527,141 @@
                  };
                }
                #endif
+         #ifndef FERRET_OBJECT_CONS_CELL
+               #define FERRET_OBJECT_CONS_CELL
+                 namespace runtime {
+                   namespace type {
+                      const size_t cons_cell = 3989;}}
+
+               #if defined(FERRET_COMPACT_CONS)
+               // List cell for builds with FERRET_COMPACT_CONS. It has no
+               // interface bases, so the object vtable is the only one, and
+               // the length fills the padding after the 32 bit reference
+               // count. Lists built by runtime::list and runtime::cons use it,
+               // runtime first, rest, cons, count and reduce know it by type.
+               class cons_cell final : public object {
+                 // Zero when the tail is not counted.
+                 unsigned int _count;
+                 var data;
+                 var next;
+
+                 static unsigned int count_of(var const & tail);
+
+               public:
+
+                 size_t type() const final { return runtime::type::cons_cell; }
+
+                 bool equals(var const & o) const final {
+                   var mine((object*)this);
+                   var other = o;
+                   for(;;){
+                     bool mine_end = mine.is_nil() || mine.is_type(runtime::type::empty_sequence);
+                     bool other_end = other.is_nil() || other.is_type(runtime::type::empty_sequence);
+                     if (mine_end || other_end)
+                       return (mine_end && other_end);
+                     if (runtime::first(mine) != runtime::first(other))
+                       return false;
+                     mine = runtime::rest(mine);
+                     other = runtime::rest(other);
+                   }
+                 }
+
+                 size_t hash() const final { return runtime::hash_ordered(var((object*)this)); }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("(");
+                   data.stream_console();
+                   for(auto const& i : runtime::range(next)){
+                     runtime::print(" ");
+                     i.stream_console();
+                   }
+                   runtime::print(")");
+                 }
+               #endif
+
+                 cons_cell(var const & d, var const & n) : _count(count_of(n)), data(d), next(n) { }
+
+                 // Releases a uniquely owned tail one cell at a time, instead
+                 // of one nested destructor call per cell.
+                 ~cons_cell(){
+                   var tail = static_cast<var&&>(next);
+                   while (!tail.is_nil() && tail.is_type(runtime::type::cons_cell) && tail.is_unique()){
+                     var after = static_cast<var&&>(tail.cast<cons_cell>()->next);
+                     tail = static_cast<var&&>(after);
+                   }
+                 }
+
+                 var const & first() const { return data; }
+
+                 var const & rest() const { return next; }
+
+                 size_t count() const { return _count; }
+
+                 bool counted(size_t & n) const final {
+                   n = _count;
+                   return (n != 0);
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   const cons_cell * c = this;
+                   for(;;){
+                     if (!rf.step(acc, c->data))
+                       return false;
+                     if (c->next.is_nil())
+                       return true;
+                     if (!c->next.is_type(runtime::type::cons_cell))
+                       return runtime::reduce(rf, acc, c->next);
+                     c = c->next.cast<cons_cell>();
+                   }
+                 }
+               };
+               #endif
+
+               namespace runtime {
+                 // Length of coll when it is known without walking it.
+                 inline bool known_count(var const & coll, size_t & n){
+                   if (coll.is_nil() || coll.is_type(type::empty_sequence)){
+                     n = 0;
+                     return true;
+                   }
+                   return coll.get()->counted(n);
+                 }
+               }
+
+               #if defined(FERRET_COMPACT_CONS)
+               inline unsigned int cons_cell::count_of(var const & tail){
+                 size_t n;
+                 if (!runtime::known_count(tail, n) || n >= (size_t)(unsigned int)-1)
+                   return 0;
+                 return (unsigned int)(n + 1);
+               }
+               #endif
+               #endif
          #ifndef FERRET_OBJECT_SEQUENCE
                #define FERRET_OBJECT_SEQUENCE
                  namespace runtime {
                    namespace type {
                       const size_t sequence = 3956;}}
 
+               // List cell. The length is kept when the cell is consed onto
+               // a counted tail, so count, nth and nthrest on lists built
+               // with cons or list do not walk them.
                class sequence final : public object, public seekable_i {
-                 const var next;
+                 var next;
                  const var data;
+                 // Zero when the tail is not counted.
+                 const size_t _count;
+                 hash_cache _hash;
+
+                 static size_t count_of(var const & tail){
+                   size_t n = 0;
+                   if (!runtime::known_count(tail, n))
+                     return 0;
+                   return n + 1;
+                 }
                public:
 
                  size_t type() const final { return runtime::type::sequence; }
@@ -1250,12 +2689,57 @@
                  }
                #endif
 
-                 explicit sequence(var const & d = nil(), var const & n = nil()) : next(n), data(d) {} 
+                 explicit sequence(var const & d = nil(), var const & n = nil()) :
+                   next(n), data(d), _count(count_of(n)) {} 
+
+                 // Releases a uniquely owned tail one cell at a time, instead
+                 // of one nested destructor call per cell.
+                 ~sequence(){
+                   var tail = static_cast<var&&>(next);
+                   while (!tail.is_nil() && tail.is_type(runtime::type::sequence) && tail.is_unique()){
+                     var after = static_cast<var&&>(tail.cast<sequence>()->next);
+                     tail = static_cast<var&&>(after);
+                   }
+                 }
+
+                 // Same as hash_ordered, walking the cells up to the first
+                 // one that has its hash cached. The result is kept on this
+                 // cell only, so hashing a list again or a list consed onto
+                 // it does not walk the shared tail.
+                 size_t hash() const final {
+                   size_t h;
+                   if (_hash.get(h))
+                     return h;
+                   h = 0;
+                   size_t p = 1;
+                   const sequence * s = this;
+                   for(;;){
+                     h += runtime::hash(s->data) * p;
+                     p *= 31;
+                     var const & tail = s->next;
+                     if (tail.is_nil()){
+                       h += p;
+                       break;
+                     }
+                     if (!tail.is_type(runtime::type::sequence)){
+                       h += p * runtime::hash_ordered(tail);
+                       break;
+                     }
+                     s = tail.cast<sequence>();
+                     size_t known;
+                     if (s->_hash.get(known)){
+                       h += p * known;
+                       break;
+                     }
+                   }
+                   _hash.set(h);
+                   return h;
+                 }
 
                  virtual seekable_i* cast_seekable_i() { return this; }
 
                  var cons(var const & x) final {
-                   return obj<sequence>(x, var(this));
+                   return runtime::make_cell(x, var(this));
                  }
                  var first() const final {
                    return data;
@@ -1263,6 +2747,27 @@
                  var rest() const final {
                    return next;
                  }
+
+                 bool counted(size_t & n) const final {
+                   n = _count;
+                   return (n != 0);
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 // Walk the cells directly, no refcount traffic per element.
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   const sequence * s = this;
+                   for(;;){
+                     if (!rf.step(acc, s->data))
+                       return false;
+                     if (s->next.is_nil())
+                       return true;
+                     if (!s->next.is_type(runtime::type::sequence))
+                       return runtime::reduce(rf, acc, s->next);
+                     s = s->next.cast<sequence>();
+                   }
+                 }
                  template <typename T>
                  static T to(var const & ){
                    T::unimplemented_function;
@@ -1277,13 +2782,37 @@
                  inline var list() { 
                    return cached::empty_sequence;
                  }
+
+                 // The one place a list cell is allocated, a cons_cell under
+                 // FERRET_COMPACT_CONS and a sequence otherwise.
+                 inline var make_cell(var const & x, var const & tail) {
+               #if defined(FERRET_COMPACT_CONS)
+                   return obj<cons_cell>(x, tail);
+               #else
+                   return obj<sequence>(x, tail);
+               #endif
+                 }
+
                  inline var list(var const & v) { 
-                   return obj<sequence>(v,nil());
+                   return make_cell(v,nil());
                  }
                                    
                  template <typename... Args>
                  inline var list(var const & first, Args const & ... args) { 
-                   return obj<sequence>(first, list(args...));
+                   return make_cell(first, list(args...));
+                 }
+
+                 // Hash shared by every sequential collection, so collections
+                 // that compare equal element wise hash the same,
+                 // h(x . xs) = hash(x) + 31 * h(xs), h(()) = 1.
+                 inline size_t hash_ordered(var const & seq) {
+                   size_t h = 0;
+                   size_t p = 1;
+                   for(auto const& it : runtime::range(seq)){
+                     h += hash(it) * p;
+                     p *= 31;
+                   }
+                   return h + p;
                  }
                }
 
@@ -1300,7 +2829,7 @@
                template <> var sequence::from(std_vector v) { 
                  var ret;
                  for(auto const& it : v)
-                   ret = runtime::cons(it,ret);
+                   ret = runtime::make_cell(it,ret);
                  return ret;
                }
                #endif
@@ -1348,6 +2877,8 @@
                  }
                #endif
 
+                 size_t hash() const final { return runtime::hash_ordered(var((object*)this)); }
+
                  explicit lazy_sequence(var const & t) : thunk(t) {} 
                  explicit lazy_sequence(var const & h, var const & t) : thunk(t), head(h) {} 
 
@@ -1355,7 +2886,7 @@
 
                  var cons(var const & x) final {
                    if (!head.is_nil())
-                     return obj<sequence>(x, obj<lazy_sequence>(head,thunk));
+                     return runtime::make_cell(x, obj<lazy_sequence>(head,thunk));
 
                    return obj<lazy_sequence>(x,thunk);
                  }
@@ -1379,6 +2910,7 @@
                class d_list final : public lambda_i, public seekable_i {
 
                  var data;
+                 exact_hash_cache _hash;
 
                  number_t val_index(var const & k) const {
                    var keys = runtime::first(data);
@@ -1394,8 +2926,69 @@
 
                  size_t type() const final { return runtime::type::d_list; }
 
+                 // Maps are equal when they hold the same entries, order
+                 // and keys shadowed by a later assoc do not matter.
                  bool equals(var const & o) const final {
-                   return (this == o.get());
+                   if (this == o.get())
+                     return true;
+                   if (!o.is_type(runtime::type::d_list))
+                     return false;
+
+                   d_list * other = o.cast<d_list>();
+                   if (_hash.differs(other->_hash))
+                     return false;
+
+                   size_t entries = 0;
+                   var keys = runtime::first(data);
+                   var values = runtime::rest(data);
+                   for(number_t i = 0; !keys.is_nil() && !runtime::first(keys).is_nil(); i++){
+                     var k = runtime::first(keys);
+                     if (val_index(k) == i){
+                       number_t at = other->val_index(k);
+                       if (at == -1 || runtime::nth(runtime::rest(other->data), at) != runtime::first(values))
+                         return false;
+                       entries++;
+                     }
+                     keys = runtime::rest(keys);
+                     values = runtime::rest(values);
+                   }
+                   return (entries == other->entries());
+                 }
+
+                 // Number of distinct keys.
+                 size_t entries() const {
+                   size_t n = 0;
+                   var keys = runtime::first(data);
+                   for(number_t i = 0; !keys.is_nil() && !runtime::first(keys).is_nil(); i++){
+                     if (val_index(runtime::first(keys)) == i)
+                       n++;
+                     keys = runtime::rest(keys);
+                   }
+                   return n;
+                 }
+
+                 // Order independent sum over the visible entries.
+                 size_t hash() const final {
+                   size_t h;
+                   if (_hash.get(h))
+                     return h;
+
+                   h = 0;
+                   bool exact = true;
+                   var keys = runtime::first(data);
+                   var values = runtime::rest(data);
+                   for(number_t i = 0; !keys.is_nil() && !runtime::first(keys).is_nil(); i++){
+                     var k = runtime::first(keys);
+                     if (val_index(k) == i){
+                       var const & v = runtime::first(values);
+                       h += runtime::hash_mix(runtime::hash(k) * 31 + runtime::hash(v));
+                       exact = exact && runtime::hash_exact(k) && runtime::hash_exact(v);
+                     }
+                     keys = runtime::rest(keys);
+                     values = runtime::rest(values);
+                   }
+                   _hash.set(h, exact);
+                   return h;
                  }
 
                #if !defined(FERRET_DISABLE_STD_OUT)
@@ -1423,6 +3016,10 @@
                    if ( idx == -1 )
                      return obj<d_list>(data);
 
+                   return obj<d_list>(without(idx));
+                 }
+
+                 var without(number_t idx) const {
                    var keys = runtime::first(data);
                    var values = runtime::rest(data);
 
@@ -1436,7 +3033,40 @@
                      if ( i.index != idx)
                        new_values = runtime::cons(i.value, new_values);
                    
-                   return obj<d_list>(runtime::cons(new_keys,new_values));
+                   return runtime::cons(new_keys,new_values);
+                 }
+
+                 // In place variants, used when the caller moves in the only
+                 // reference to the map.
+                 static var assoc(var && m, var const & k, var const & v){
+                   if (!m.is_unique())
+                     return m.cast<d_list>()->assoc(k, v);
+
+                   // Keys and values are lists, each needs a new head
+                   // cell. The old pair cell is let go first so the
+                   // allocator can hand its block to the new one.
+                   d_list * d = m.cast<d_list>();
+                   var keys = runtime::first(d->data);
+                   var values = runtime::rest(d->data);
+                   d->data = nil();
+                   keys = runtime::cons(k, keys);
+                   values = runtime::cons(v, values);
+                   d->data = runtime::cons(keys, values);
+                   d->_hash.reset();
+                   return static_cast<var&&>(m);
+                 }
+
+                 static var dissoc(var && m, var const & k){
+                   if (!m.is_unique())
+                     return m.cast<d_list>()->dissoc(k);
+
+                   d_list * d = m.cast<d_list>();
+                   number_t idx = d->val_index(k);
+                   if ( idx != -1 ){
+                     d->data = d->without(idx);
+                     d->_hash.reset();
+                   }
+                   return static_cast<var&&>(m);
                  }
                  
                  var val_at(var const & args) const {
@@ -1488,6 +3118,18 @@
                    
                    return obj<d_list>(runtime::cons(runtime::rest(keys),runtime::rest(values)));
                  }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   for(auto const& it : runtime::range_pair(runtime::first(data),runtime::rest(data))){
+                     if (it.first.is_nil())
+                       break;
+                     if (!rf.step(acc, runtime::list(it.first, it.second)))
+                       return false;
+                   }
+                   return true;
+                 }
                };
                #endif
          #ifndef FERRET_OBJECT_KEYWORD
@@ -1516,6 +3158,10 @@
                    return (_word == o.cast<keyword>()->word());
                  }
 
+                 size_t hash() const final { return runtime::hash_mix((size_t)_word); }
+
+                 bool hash_exact() const final { return true; }
+
                #if !defined(FERRET_DISABLE_STD_OUT)
                  void stream_console() const final {
                    runtime::print("keyword<");
@@ -1562,7 +3208,16 @@
                  size_t type() const final { return runtime::type::string; }
 
                  bool equals(var const & other) const final {
-                   return (container() == other.cast<string>()->container());
+                   if (other.is_type(runtime::type::string))
+                     return (container() == other.cast<string>()->container());
+                   return (container() == other);
+                 }
+
+                 // Hash of the list of characters. Its sequence cells cache
+                 // their hash, the cons_cell ones of FERRET_COMPACT_CONS
+                 // do not.
+                 size_t hash() const final {
+                   return data.is_nil() ? 1 : runtime::hash(data);
                  }
 
                #if !defined(FERRET_DISABLE_STD_OUT)
@@ -1594,6 +3249,16 @@
                    return obj<string>(runtime::cons(x,data));
                  }
 
+                 static var cons(var const & x, var && s){
+                   if (!s.is_unique())
+                     return s.cast<string>()->cons(x);
+                   // The string object is reused, its characters are a
+                   // list and a new head still takes one cell.
+                   string * str = s.cast<string>();
+                   str->data = runtime::cons(x,str->data);
+                   return static_cast<var&&>(s);
+                 }
+
                  var first() const final {
                    return runtime::first(data);
                  }
@@ -1605,6 +3270,17 @@
                    return cached::empty_sequence;
                  }
 
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   return runtime::reduce(rf, acc, data);
+                 }
+
+                 // Counted as long as its characters are.
+                 bool counted(size_t & n) const final {
+                   return runtime::known_count(data, n);
+                 }
+
                  template <typename T>
                  static T to(var const & ){
                    T::unimplemented_function;
@@ -1619,52 +3295,432 @@
                  return var(new(storage) string(s.c_str(), (number_t)s.size()));
                }
 
-               template <> ::std::string string::to(var const & v) { 
-                 ::std::stringstream ss;
-                 for(auto const& it : runtime::range(v.cast<string>()->container()))
-                   ss << number::to<char>(it);
-                 return ss.str();
-               }
+               // Defined along with rope, which it lays out as well.
+               template <> ::std::string string::to(var const & v);
                #endif
                #endif
-         #ifndef FERRET_OBJECT_ATOMIC
-               #define FERRET_OBJECT_ATOMIC
+         #ifndef FERRET_OBJECT_ROPE
+               #define FERRET_OBJECT_ROPE
                  namespace runtime {
                    namespace type {
-                      const size_t atomic = 3961;}}
+                      const size_t rope = 3991;
+                      const size_t rope_seq = 3994;}}
 
-               class atomic final : public deref_i {
-                 var data;
-                 mutex lock;
-                 public:
+               #ifdef FERRET_STD_LIB
+               #if !defined(FERRET_ROPE_LEAF_SIZE)
+                 # define FERRET_ROPE_LEAF_SIZE 256
+               #endif
 
+               // Text as a height balanced tree of contiguous chunks. Joining
+               // and slicing copy O(log n) nodes and at most a leaf of
+               // characters, the whole text is only laid out in one buffer
+               // when asked for with text() or string::to<std::string>.
+               class rope final : public object, public seekable_i {
+                 const var left;
+                 const var right;
+                 const ::std::string chunk;
+                 const size_t _length;
+                 const size_t _depth;
+                 hash_cache _hash;
 
-                 size_t type() const final { return runtime::type::atomic; }
+                 bool leaf() const { return left.is_nil(); }
 
-                 bool equals(var const & o) const final {
-                   return (this == o.cast<atomic>());
+                 static rope * of_node(var const & n) { return n.cast<rope>(); }
+
+                 static var make(var const & l, var const & r){
+                   return obj<rope>(l, r);
                  }
 
-               #if !defined(FERRET_DISABLE_STD_OUT)
-                 void stream_console() const final {
-                   runtime::print("atom<");
-                   data.stream_console();
-                   runtime::print(">");
+                 // l and r are balanced and their depths differ by two at
+                 // most, rotates the taller side up.
+                 static var balance(var const & l, var const & r){
+                   rope * L = of_node(l);
+                   rope * R = of_node(r);
+                   if (L->_depth > R->_depth + 1){
+                     if (of_node(L->left)->_depth >= of_node(L->right)->_depth)
+                       return make(L->left, make(L->right, r));
+                     rope * LR = of_node(L->right);
+                     return make(make(L->left, LR->left), make(LR->right, r));
+                   }
+                   if (R->_depth > L->_depth + 1){
+                     if (of_node(R->right)->_depth >= of_node(R->left)->_depth)
+                       return make(make(l, R->left), R->right);
+                     rope * RL = of_node(R->left);
+                     return make(make(l, RL->left), make(RL->right, R->right));
+                   }
+                   return make(l, r);
                  }
-               #endif
 
-                 explicit atomic(var const & d) : data(d) {} 
+                 static bool fits(rope const * a, rope const * b){
+                   return (a->leaf() && b->leaf() &&
+                           a->_length + b->_length <= FERRET_ROPE_LEAF_SIZE);
+                 }
 
-                 var swap(var const & f,var const & args){
-                   lock_guard guard(lock);
-                   data = f.cast<lambda_i>()->invoke(runtime::cons(data, args));
-                   return data;
+                 static var join(var const & a, var const & b){
+                   rope * A = of_node(a);
+                   rope * B = of_node(b);
+                   if (A->_length == 0)
+                     return b;
+                   if (B->_length == 0)
+                     return a;
+                   if (fits(A, B))
+                     return obj<rope>(A->chunk + B->chunk);
+                   if (A->_depth > B->_depth + 1)
+                     return balance(A->left, join(A->right, b));
+                   if (B->_depth > A->_depth + 1)
+                     return balance(join(a, B->left), B->right);
+                   // Small pieces added at either end go into the leaf
+                   // next to them, building text piecewise fills leaves up.
+                   if (!A->leaf() && fits(of_node(A->right), B))
+                     return balance(A->left, obj<rope>(of_node(A->right)->chunk + B->chunk));
+                   if (!B->leaf() && fits(A, of_node(B->left)))
+                     return balance(obj<rope>(A->chunk + of_node(B->left)->chunk), B->right);
+                   return make(a, b);
                  }
-                 var deref() {
-                   lock_guard guard(lock);
-                   return data;
+
+                 static var slice(var const & n, size_t start, size_t end){
+                   rope * r = of_node(n);
+                   if (start == 0 && end == r->_length)
+                     return n;
+                   if (start >= end)
+                     return obj<rope>(::std::string());
+                   if (r->leaf())
+                     return obj<rope>(r->chunk.substr(start, end - start));
+                   size_t split = of_node(r->left)->_length;
+                   if (end <= split)
+                     return slice(r->left, start, end);
+                   if (start >= split)
+                     return slice(r->right, start - split, end - split);
+                   return join(slice(r->left, start, split), slice(r->right, 0, end - split));
                  }
-               };
+
+                 // Calls f with each leaf in order, stops when f returns false.
+                 template<typename F>
+                 bool leaves(F f) const {
+                   const rope * stack[64];
+                   size_t top = 0;
+                   const rope * n = this;
+                   for(;;){
+                     while (!n->leaf()){
+                       stack[top++] = of_node(n->right);
+                       n = of_node(n->left);
+                     }
+                     if (!f(n->chunk))
+                       return false;
+                     if (top == 0)
+                       return true;
+                     n = stack[--top];
+                   }
+                 }
+
+               public:
+
+                 size_t type() const final { return runtime::type::rope; }
+
+                 bool equals(var const & o) const final {
+                   if (!o.is_nil() && o.is_type(runtime::type::rope)){
+                     rope * r = of_node(o);
+                     return (_length == r->_length && text() == r->text());
+                   }
+                   var other = o;
+                   bool same = leaves([&other](::std::string const & s){
+                       for(size_t i = 0; i < s.size(); i++){
+                         if (obj<number>((number_t)s[i]) != runtime::first(other))
+                           return false;
+                         other = runtime::rest(other);
+                       }
+                       return true;
+                     });
+                   return (same && runtime::first(other).is_nil());
+                 }
+
+                 // Matches the hash of a string with the same characters.
+                 size_t hash() const final {
+                   size_t h;
+                   if (_hash.get(h))
+                     return h;
+                   h = 0;
+                   size_t p = 1;
+                   leaves([&h, &p](::std::string const & s){
+                       for(size_t i = 0; i < s.size(); i++){
+                         h += number::hash_of((real_t)(number_t)s[i]) * p;
+                         p *= 31;
+                       }
+                       return true;
+                     });
+                   h += p;
+                   _hash.set(h);
+                   return h;
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   leaves([](::std::string const & s){
+                       runtime::print(s);
+                       return true;
+                     });
+                 }
+               #endif
+
+                 explicit rope(::std::string const & s) :
+                   chunk(s), _length(s.size()), _depth(0) { }
+
+                 rope(var const & l, var const & r) :
+                   left(l), right(r),
+                   _length(of_node(l)->_length + of_node(r)->_length),
+                   _depth(1 + ::std::max(of_node(l)->_depth, of_node(r)->_depth)) { }
+
+                 // Rope of any text, a rope is returned as is and anything
+                 // else seqable is read as a sequence of character codes.
+                 static var of(var const & s){
+                   if (!s.is_nil() && s.is_type(runtime::type::rope))
+                     return s;
+                   var chars = s;
+                   if (!s.is_nil() && s.is_type(runtime::type::string))
+                     chars = s.cast<string>()->container();
+                   ::std::string text;
+                   for(auto const& c : runtime::range(chars))
+                     text += number::to<char>(c);
+                   var r = obj<rope>(::std::string());
+                   for(size_t i = 0; i < text.size(); i += FERRET_ROPE_LEAF_SIZE)
+                     r = join(r, obj<rope>(text.substr(i, FERRET_ROPE_LEAF_SIZE)));
+                   return r;
+                 }
+
+                 static var concat(var const & a, var const & b){
+                   return join(of(a), of(b));
+                 }
+
+                 // Characters from start up to, not including, end.
+                 var sub(size_t start, size_t end) const {
+                   end = runtime::min(end, _length);
+                   return slice(var((object*)this), runtime::min(start, end), end);
+                 }
+
+                 // Leaf holding character i, i becomes the offset into it.
+                 const rope * leaf_at(size_t & i) const {
+                   const rope * n = this;
+                   while (!n->leaf()){
+                     size_t split = of_node(n->left)->_length;
+                     if (i < split){
+                       n = of_node(n->left);
+                     }else{
+                       i -= split;
+                       n = of_node(n->right);
+                     }
+                   }
+                   return n;
+                 }
+
+                 char char_at(size_t i) const {
+                   return leaf_at(i)->chunk[i];
+                 }
+
+                 // Characters of a leaf.
+                 ::std::string const & chars() const { return chunk; }
+
+                 size_t depth() const { return _depth; }
+
+                 ::std::string text() const {
+                   ::std::string s;
+                   s.reserve(_length);
+                   leaves([&s](::std::string const & c){
+                       s += c;
+                       return true;
+                     });
+                   return s;
+                 }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return join(obj<rope>(::std::string(1, number::to<char>(x))), var(this));
+                 }
+
+                 var first() const final {
+                   if (_length == 0)
+                     return nil();
+                   return obj<number>((number_t)char_at(0));
+                 }
+
+                 var rest() const final;
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   return leaves([&rf, &acc](::std::string const & s){
+                       for(size_t i = 0; i < s.size(); i++)
+                         if (!rf.step(acc, obj<number>((number_t)s[i])))
+                           return false;
+                       return true;
+                     });
+                 }
+
+                 bool counted(size_t & n) const final { n = count(); return true; }
+
+                 size_t count() const { return _length; }
+               };
+
+               // Rest of a rope from character pos on, a leaf and an offset
+               // into it. Stepping through the text neither copies it nor
+               // rebuilds nodes, the next leaf is looked up from the root
+               // once the current one is used up.
+               class rope_seq final : public object, public seekable_i {
+                 const var root;
+                 const var leaf;
+                 const size_t offset;
+                 const size_t pos;
+
+                 // Calls f with each remaining character, stops when f
+                 // returns false.
+                 template<typename F>
+                 bool each(F f) const {
+                   rope * r = root.cast<rope>();
+                   const rope * l = leaf.cast<rope>();
+                   size_t i = offset;
+                   size_t at = pos;
+                   for(;;){
+                     ::std::string const & s = l->chars();
+                     for(; i < s.size(); i++, at++)
+                       if (!f(s[i]))
+                         return false;
+                     if (at >= r->count())
+                       return true;
+                     i = at;
+                     l = r->leaf_at(i);
+                   }
+                 }
+
+               public:
+
+                 size_t type() const final { return runtime::type::rope_seq; }
+
+                 bool equals(var const & o) const final {
+                   var other = o;
+                   bool same = each([&other](char c){
+                       if (obj<number>((number_t)c) != runtime::first(other))
+                         return false;
+                       other = runtime::rest(other);
+                       return true;
+                     });
+                   return (same && runtime::first(other).is_nil());
+                 }
+
+                 // Matches the hash of a string with the same characters.
+                 size_t hash() const final {
+                   size_t h = 0;
+                   size_t p = 1;
+                   each([&h, &p](char c){
+                       h += number::hash_of((real_t)(number_t)c) * p;
+                       p *= 31;
+                       return true;
+                     });
+                   return h + p;
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   each([](char c){
+                       runtime::print(c);
+                       return true;
+                     });
+                 }
+               #endif
+
+                 rope_seq(var const & r, var const & l, size_t o, size_t p) :
+                   root(r), leaf(l), offset(o), pos(p) { }
+
+                 // Characters of root from pos on, the empty sequence past
+                 // the end.
+                 static var from(var const & root, size_t pos){
+                   if (pos >= root.cast<rope>()->count())
+                     return cached::empty_sequence;
+                   size_t i = pos;
+                   const rope * l = root.cast<rope>()->leaf_at(i);
+                   return obj<rope_seq>(root, var((object*)l), i, pos);
+                 }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return runtime::make_cell(x, var(this));
+                 }
+
+                 var first() const final {
+                   return obj<number>((number_t)leaf.cast<rope>()->chars()[offset]);
+                 }
+
+                 var rest() const final {
+                   if (offset + 1 < leaf.cast<rope>()->count())
+                     return obj<rope_seq>(root, leaf, offset + 1, pos + 1);
+                   return from(root, pos + 1);
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   return each([&rf, &acc](char c){
+                       return rf.step(acc, obj<number>((number_t)c));
+                     });
+                 }
+
+                 bool counted(size_t & n) const final { n = count(); return true; }
+
+                 size_t count() const { return root.cast<rope>()->count() - pos; }
+               };
+
+               inline var rope::rest() const {
+                 return rope_seq::from(var((object*)this), 1);
+               }
+
+               template <> ::std::string string::to(var const & v) { 
+                 if (v.is_type(runtime::type::rope))
+                   return v.cast<rope>()->text();
+                 ::std::string s;
+                 for(auto const& it : runtime::range(v.cast<string>()->container()))
+                   s += number::to<char>(it);
+                 return s;
+               }
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_ATOMIC
+               #define FERRET_OBJECT_ATOMIC
+                 namespace runtime {
+                   namespace type {
+                      const size_t atomic = 3961;}}
+
+               class atomic final : public deref_i {
+                 var data;
+                 mutex lock;
+                 public:
+
+
+                 size_t type() const final { return runtime::type::atomic; }
+
+                 bool equals(var const & o) const final {
+                   return (this == o.cast<atomic>());
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("atom<");
+                   data.stream_console();
+                   runtime::print(">");
+                 }
+               #endif
+
+                 explicit atomic(var const & d) : data(d) {} 
+
+                 var swap(var const & f,var const & args){
+                   lock_guard guard(lock);
+                   data = runtime::apply(f, runtime::cons(data, args));
+                   return data;
+                 }
+                 var deref() {
+                   lock_guard guard(lock);
+                   return data;
+                 }
+               };
                #endif
          #ifndef FERRET_OBJECT_ASYNC
                #define FERRET_OBJECT_ASYNC
@@ -1678,6 +3734,7 @@
                  mutex lock;
                  var fn;
                  bool cached;
+                 std::atomic<bool> ready;
                  std::future<var> task;
 
                  class rc_guard{
@@ -1690,13 +3747,18 @@
 
                  var exec() {
                    rc_guard g(this);
+                   FERRET_TRACE_ASYNC_SCOPE(typeid(*fn.get()));
+                   struct mark_ready{
+                     std::atomic<bool> & flag;
+                     ~mark_ready() { flag.store(true, std::memory_order_release); }
+                   } mark{ready};
                    return run(fn);
                  }
                  
                  public:
 
                  explicit async(var const & f) :
-                   value(nil()), fn(f), cached(false),
+                   value(nil()), fn(f), cached(false), ready(false),
                    task(std::async(std::launch::async, [this](){ return exec(); })){ inc_ref(); }
 
                  size_t type() const final { return runtime::type::async; }
@@ -1713,11 +3775,11 @@
                  }
                #endif
 
-                 bool is_ready(){
-                   lock_guard guard(lock);
-                   if (cached)
-                     return true;
-                   return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+                 // Lock free, set once the function returned or threw. The
+                 // result may still be on its way into the future, deref
+                 // will at most wait for that hand over.
+                 bool is_ready() const {
+                   return ready.load(std::memory_order_acquire);
                  }
 
                  void get(){
@@ -1732,6 +3794,15 @@
                    get();
                    return value;
                  }
+
+                 var deref(number_t ms, var const & timeout_val) {
+                   lock_guard guard(lock);
+                   if (!cached &&
+                       task.wait_for(std::chrono::milliseconds(ms)) != std::future_status::ready)
+                     return timeout_val;
+                   get();
+                   return value;
+                 }
                };
                #endif
                #endif
@@ -1745,6 +3816,27 @@
                  var val;
                  mutex lock;
                  var fn;
+               #if defined(FERRET_STD_LIB)
+                 ::std::atomic<bool> realized;
+               #else
+                 bool realized;
+               #endif
+
+                 inline bool is_realized() const {
+               #if defined(FERRET_STD_LIB)
+                   return realized.load(::std::memory_order_acquire);
+               #else
+                   return realized;
+               #endif
+                 }
+
+                 inline void mark_realized() {
+               #if defined(FERRET_STD_LIB)
+                   realized.store(true, ::std::memory_order_release);
+               #else
+                   realized = true;
+               #endif
+                 }
                  
                  public:
 
@@ -1760,13 +3852,21 @@
                  }
                #endif
 
-                 explicit delayed(var const & f) : fn(f) {} 
-                 
+                 explicit delayed(var const & f) : fn(f), realized(false) {} 
+
+                 // Once realized deref is a single acquire load. Until then
+                 // one thread runs fn while the others wait on the lock, if
+                 // fn throws the delay stays unrealized and the next deref
+                 // runs it again.
                  var deref() {
+                   if (is_realized())
+                     return val;
+
                    lock_guard guard(lock);
-                   if (!fn.is_nil()){
-                     val = fn.cast<lambda_i>()->invoke(nil());
+                   if (!is_realized()){
+                     val = runtime::apply(fn, nil());
                      fn = nil();
+                     mark_realized();
                    }
                    return val;
                  }
@@ -1994,110 +4094,6588 @@
                  }
                };
                #endif
-        }
-
-        namespace f { 
-         using namespace ferret;
-         typedef ferret::boolean boolean; 
-        }
+         #ifndef FERRET_OBJECT_BYTE_BLOCK
+               #define FERRET_OBJECT_BYTE_BLOCK
+                 namespace runtime {
+                   namespace type {
+                      const size_t byte_block = 3968;}}
 
-        // Symbols
-        namespace f{
-        }
+               #ifdef FERRET_STD_LIB
+               // Raw heap buffer shared by the slices pointing into it.
+               class byte_block final : public object {
+                 char * _data;
+                 size_t _capacity;
+               public:
 
+                 size_t type() const final { return runtime::type::byte_block; }
 
-        // Runtime Implementations
-        #ifndef FERRET_RUNTIME_CPP
-        #define FERRET_RUNTIME_CPP
+                 bool equals(var const & o) const final {
+                   return (this == o.get());
+                 }
 
-         namespace ferret{
-           namespace runtime{
-             var first(var const & coll){
-               if (coll.is_nil() || coll.is_type(runtime::type::empty_sequence))
-                 return nil();
-               else
-                 return coll.cast<seekable_i>()->first();
-             }
-           
-             var rest(var const & coll){
-               if (coll.is_nil())
-                 return runtime::list();
-               if (coll.is_type(runtime::type::empty_sequence))
-                 return nil();
-               return coll.cast<seekable_i>()->rest();
-             }
-           
-             var cons(var const & x, var const & coll){
-               if (coll.is_nil() || coll == runtime::list())
-                 return runtime::list(x);
-           
-               return coll.cast<seekable_i>()->cons(x);
-             }
-           
-             var nth(var const & seq, number_t index){
-               for(auto const& i : range_indexed(seq))
-                 if (index == i.index)
-                   return i.value;
-           
-               return nil();
-             }
-           
-             var nthrest(var const & seq, number_t index){
-               var ret = seq;
-               for(number_t i = 0; i < index; i++)
-                 ret = runtime::rest(ret);
-           
-               if (ret.is_nil())
-                 return runtime::list(); 
-           
-               return ret;
-             }
-             
-             size_t count(var const & seq){
-               size_t acc = 0;
-               for(auto const& v : runtime::range(seq)){
-                 (void)v;
-                 acc++;
-               }
-               return acc;
-             }
-           
-             bool is_seqable(var const & seq){
-               if(seq.cast<seekable_i>())
-                 return true;
-               else
-                 return false;
-             }
-           }
-           template<typename T, typename... Args>
-           inline var run(T const & fn, Args const & ... args) {
-             return fn.invoke(runtime::list(args...));
-           }
-           
-           template<typename T>
-           inline var run(T const & fn) {
-             return fn.invoke(nil());
-           }
-           
-           template<>
-           inline var run(var const & fn) {
-             return fn.cast<lambda_i>()->invoke(nil());
-           }
-           
-           template<typename... Args>
-           inline var run(var const & fn, Args const & ... args) {
-             return fn.cast<lambda_i>()->invoke(runtime::list(args...));
-           }
-         }
-        #endif
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("byte_block<");
+                   runtime::print(_capacity);
+                   runtime::print(">");
+                 }
+               #endif
 
-        // Lambda Prototypes
-        namespace f{
-                 class second  {
-                public:
+                 explicit byte_block(size_t capacity) :
+                   _data((char *)::malloc(capacity)), _capacity(capacity) { }
 
-                  var invoke (var const & _args_) const  ;
-                };
+                 ~byte_block() { ::free(_data); }
+
+                 char * data() const { return _data; }
+                 size_t capacity() const { return _capacity; }
+               };
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_STRING_SLICE
+               #define FERRET_OBJECT_STRING_SLICE
+                 namespace runtime {
+                   namespace type {
+                      const size_t string_slice = 3969;}}
+
+               #ifdef FERRET_STD_LIB
+               // Read only characters owned by another object (a byte_block,
+               // a mapped file, ...). Never copies, the owner is kept alive
+               // for as long as the slice is.
+               class string_slice final : public object, public seekable_i {
+                 const var owner;
+                 const char * const _begin;
+                 const size_t _length;
+                 hash_cache _hash;
+               public:
+
+                 size_t type() const final { return runtime::type::string_slice; }
+
+                 bool equals(var const & o) const final {
+                   if (o.is_nil())
+                     return false;
+
+                   if (o.is_type(runtime::type::string_slice)){
+                     string_slice * s = o.cast<string_slice>();
+                     return (_length == s->length() &&
+                             ::memcmp(_begin, s->begin(), _length) == 0);
+                   }
+
+                   if (!o.is_type(runtime::type::empty_sequence) && !runtime::is_seqable(o))
+                     return false;
+
+                   // Any other sequence of characters, it may be shorter
+                   // or hold things that are not numbers.
+                   var other = o;
+                   for(size_t i = 0; i < _length; i++){
+                     if (other.is_nil() || other.is_type(runtime::type::empty_sequence))
+                       return false;
+                     var c = runtime::first(other);
+                     if (c.is_nil() || !c.is_type(runtime::type::number) || number::to<char>(c) != _begin[i])
+                       return false;
+                     other = runtime::rest(other);
+                   }
+                   return (other.is_nil() || other.is_type(runtime::type::empty_sequence) ||
+                           runtime::first(other).is_nil());
+                 }
+
+                 // Matches the hash of a string with the same characters.
+                 size_t hash() const final {
+                   size_t h;
+                   if (_hash.get(h))
+                     return h;
+
+                   h = 0;
+                   size_t p = 1;
+                   for(size_t i = 0; i < _length; i++){
+                     h += number::hash_of((real_t)(number_t)_begin[i]) * p;
+                     p *= 31;
+                   }
+                   h += p;
+                   _hash.set(h);
+                   return h;
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   ::std::cout.write(_begin, (::std::streamsize)_length);
+                 }
+               #endif
+
+                 explicit string_slice(var const & o, const char * b, size_t l) :
+                   owner(o), _begin(b), _length(l) { }
+
+                 const char * begin() const { return _begin; }
+                 size_t length() const { return _length; }
+
+                 ::std::string str() const { return ::std::string(_begin, _length); }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return runtime::make_cell(x, var(this));
+                 }
+
+                 var first() const final {
+                   if (_length == 0)
+                     return nil();
+                   return obj<number>((number_t)_begin[0]);
+                 }
+
+                 var rest() const final {
+                   if (_length <= 1)
+                     return cached::empty_sequence;
+                   return obj<string_slice>(owner, _begin + 1, _length - 1);
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   for(size_t i = 0; i < _length; i++)
+                     if (!rf.step(acc, obj<number>((number_t)_begin[i])))
+                       return false;
+                   return true;
+                 }
+
+                 bool counted(size_t & n) const final { n = count(); return true; }
+
+                 size_t count() const { return _length; }
+               };
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_LINE_SEQUENCE
+               #define FERRET_OBJECT_LINE_SEQUENCE
+                 namespace runtime {
+                   namespace type {
+                      const size_t line_reader = 3970;
+                      const size_t line_sequence = 3971;}}
+
+               #ifdef FERRET_POSIX
+               #if !defined(FERRET_IO_BLOCK_SIZE)
+                 # define FERRET_IO_BLOCK_SIZE 1_MB
+               #endif
+
+               // Splits a file descriptor into lines. Input is read in large
+               // blocks, lines are slices of the block they were found in. A
+               // line crossing a block boundary is carried over to the front
+               // of the next block, which grows for lines longer than a block.
+               class line_reader final : public object {
+                 const int fd;
+                 var block;
+                 size_t pos;
+                 size_t end;
+                 bool eof;
+                 mutex lock;
+
+                 void refill(){
+                   size_t carry = end - pos;
+                   size_t capacity = FERRET_IO_BLOCK_SIZE;
+                   while (capacity < carry * 2)
+                     capacity *= 2;
+
+                   // Reuse the block when no slice still points into it.
+                   var next;
+                   if (!block.is_nil() && block.is_unique() &&
+                       block.cast<byte_block>()->capacity() >= capacity)
+                     next = block;
+                   else
+                     next = obj<byte_block>(capacity);
+
+                   char * data = next.cast<byte_block>()->data();
+                   if (carry != 0)
+                     ::memmove(data, block.cast<byte_block>()->data() + pos, carry);
+
+                   block = next;
+                   pos = 0;
+                   end = carry;
+                   capacity = block.cast<byte_block>()->capacity();
+
+                   while (end < capacity){
+                     ssize_t n = ::read(fd, data + end, capacity - end);
+                     if (n < 0 && errno == EINTR)
+                       continue;
+                     if (n <= 0){
+                       eof = true;
+                       break;
+                     }
+                     end += (size_t)n;
+                     if (::memchr(data + end - (size_t)n, '\n', (size_t)n) != nullptr)
+                       break;
+                   }
+                 }
+
+                 var slice(size_t from, size_t to){
+                   const char * data = block.cast<byte_block>()->data();
+                   if (to > from && data[to - 1] == '\r')
+                     to--;
+                   return obj<string_slice>(block, data + from, to - from);
+                 }
+
+               public:
+
+                 size_t type() const final { return runtime::type::line_reader; }
+
+                 bool equals(var const & o) const final {
+                   return (this == o.get());
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("line_reader<");
+                   runtime::print(fd);
+                   runtime::print(">");
+                 }
+               #endif
+
+                 explicit line_reader(int f) : fd(f), pos(0), end(0), eof(false) { }
+
+                 var next_line(){
+                   lock_guard guard(lock);
+                   for(;;){
+                     if (pos < end){
+                       const char * data = block.cast<byte_block>()->data();
+                       const char * nl = (const char *)::memchr(data + pos, '\n', end - pos);
+                       if (nl != nullptr){
+                         size_t from = pos;
+                         pos = (size_t)(nl - data) + 1;
+                         return slice(from, pos - 1);
+                       }
+                     }
+
+                     if (eof){
+                       if (pos == end)
+                         return nil();
+                       size_t from = pos;
+                       pos = end;
+                       return slice(from, end);
+                     }
+
+                     refill();
+                   }
+                 }
+               };
+
+               class line_sequence final : public object, public seekable_i {
+                 const var reader;
+                 const var line;
+                 mutable var next;
+                 mutable bool realized;
+                 mutable mutex lock;
+               public:
+
+                 size_t type() const final { return runtime::type::line_sequence; }
+
+                 bool equals(var const & o) const final {
+                   if(first() != runtime::first(o))
+                     return false;
+
+                   for(auto const& it : runtime::range_pair(rest(),runtime::rest(o)))
+                     if (it.first != it.second)
+                       return false;
+
+                   return true;
+                 }
+
+                 size_t hash() const final { return runtime::hash_ordered(var((object*)this)); }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("(");
+                   line.stream_console();
+                   for(auto const& i : runtime::range(rest())){
+                     runtime::print(" ");
+                     i.stream_console();
+                   }
+                   runtime::print(")");
+                 }
+               #endif
+
+                 explicit line_sequence(var const & r, var const & l) :
+                   reader(r), line(l), realized(false) { }
+
+                 static var from(var const & reader){
+                   var l = reader.cast<line_reader>()->next_line();
+                   if (l.is_nil())
+                     return cached::empty_sequence;
+                   return obj<line_sequence>(reader, l);
+                 }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return runtime::make_cell(x, var(this));
+                 }
+
+                 var first() const final {
+                   return line;
+                 }
+
+                 var rest() const final {
+                   lock_guard guard(lock);
+                   if (!realized){
+                     next = from(reader);
+                     realized = true;
+                   }
+                   return next;
+                 }
+               };
+
+               // Consume with first/rest rather than runtime::range to keep
+               // memory constant, range holds on to the head of the sequence.
+               namespace runtime {
+                 inline var line_seq(int fd = 0) {
+                   return line_sequence::from(obj<line_reader>(fd));
+                 }
+               }
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_ARRAY_VIEW
+               #define FERRET_OBJECT_ARRAY_VIEW
+                 namespace runtime {
+                   namespace type {
+                      const size_t array_view = 3972;}}
+
+               #ifdef FERRET_STD_LIB
+               // Typed read only window over memory owned by another object.
+               // Elements are boxed into numbers only when accessed through
+               // the sequence interface.
+               template <typename T>
+               class array_view final : public object, public seekable_i {
+                 const var owner;
+                 const T * const _data;
+                 const size_t _size;
+               public:
+
+                 size_t type() const final { return runtime::type::array_view; }
+
+                 bool equals(var const & o) const final {
+                   var other = o;
+                   for(size_t i = 0; i < _size; i++){
+                     if (obj<number>(_data[i]) != runtime::first(other))
+                       return false;
+                     other = runtime::rest(other);
+                   }
+                   return runtime::first(other).is_nil();
+                 }
+
+                 size_t hash() const final { return runtime::hash_ordered(var((object*)this)); }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("(");
+                   for(size_t i = 0; i < _size; i++){
+                     if (i != 0)
+                       runtime::print(" ");
+                     runtime::print((real_t)_data[i]);
+                   }
+                   runtime::print(")");
+                 }
+               #endif
+
+                 explicit array_view(var const & o, const T * d, size_t s) :
+                   owner(o), _data(d), _size(s) { }
+
+                 const T * data() const { return _data; }
+                 size_t size() const { return _size; }
+                 T operator[](size_t idx) const { return _data[idx]; }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return runtime::make_cell(x, var(this));
+                 }
+
+                 var first() const final {
+                   if (_size == 0)
+                     return nil();
+                   return obj<number>(_data[0]);
+                 }
+
+                 var rest() const final {
+                   if (_size <= 1)
+                     return cached::empty_sequence;
+                   return obj<array_view<T>>(owner, _data + 1, _size - 1);
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   for(size_t i = 0; i < _size; i++)
+                     if (!rf.step(acc, obj<number>(_data[i])))
+                       return false;
+                   return true;
+                 }
+
+                 bool counted(size_t & n) const final { n = count(); return true; }
+
+                 size_t count() const { return _size; }
+               };
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_MAPPED_FILE
+               #define FERRET_OBJECT_MAPPED_FILE
+                 namespace runtime {
+                   namespace type {
+                      const size_t mapped_file = 3973;
+                      const size_t mapped_lines = 3974;}}
+
+               #ifdef FERRET_POSIX
+               // Read only mapping of a whole file, unmapped when the last
+               // var referring to it, or to a view into it, goes away.
+               class mapped_file final : public object {
+                 const char * _data;
+                 size_t _size;
+               public:
+
+                 size_t type() const final { return runtime::type::mapped_file; }
+
+                 bool equals(var const & o) const final {
+                   return (this == o.get());
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("mapped_file<");
+                   runtime::print(_size);
+                   runtime::print(">");
+                 }
+               #endif
+
+                 explicit mapped_file(const char * path) : _data(nullptr), _size(0) {
+                   int fd = ::open(path, O_RDONLY);
+                   if (fd < 0)
+                     return;
+
+                   // An empty file can not be mapped, it gets an empty
+                   // buffer so it still tells apart from a failure.
+                   struct stat st;
+                   if (::fstat(fd, &st) == 0){
+                     if (st.st_size == 0){
+                       _data = "";
+                     }else{
+                       void * p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                       if (p != MAP_FAILED){
+                         ::madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+                         ::madvise(p, (size_t)st.st_size, MADV_WILLNEED);
+                         _data = (const char *)p;
+                         _size = (size_t)st.st_size;
+                       }
+                     }
+                   }
+                   ::close(fd);
+                 }
+
+                 ~mapped_file(){
+                   if (_size != 0)
+                     ::munmap((void *)_data, _size);
+                 }
+
+                 const char * data() const { return _data; }
+                 size_t size() const { return _size; }
+
+                 var text(){
+                   return obj<string_slice>(var(this), _data, _size);
+                 }
+
+                 var bytes(){
+                   return view<uint8_t>();
+                 }
+
+                 // offset must keep T aligned, trailing bytes that do not
+                 // make up a whole T are left out.
+                 template <typename T>
+                 var view(size_t offset = 0){
+                   if (offset > _size)
+                     offset = _size;
+                   return obj<array_view<T>>(var(this), (const T *)(_data + offset),
+                                             (_size - offset) / sizeof(T));
+                 }
+
+                 var lines();
+               };
+
+               class mapped_lines final : public object, public seekable_i {
+                 const var owner;
+                 const char * const pos;
+                 const char * const end;
+                 const size_t length;
+
+                 static size_t line_length(const char * p, const char * e){
+                   const char * nl = (const char *)::memchr(p, '\n', (size_t)(e - p));
+                   return (nl == nullptr) ? (size_t)(e - p) : (size_t)(nl - p);
+                 }
+               public:
+
+                 size_t type() const final { return runtime::type::mapped_lines; }
+
+                 bool equals(var const & o) const final {
+                   if(first() != runtime::first(o))
+                     return false;
+
+                   for(auto const& it : runtime::range_pair(rest(),runtime::rest(o)))
+                     if (it.first != it.second)
+                       return false;
+
+                   return true;
+                 }
+
+                 size_t hash() const final { return runtime::hash_ordered(var((object*)this)); }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("(");
+                   first().stream_console();
+                   for(auto const& i : runtime::range(rest())){
+                     runtime::print(" ");
+                     i.stream_console();
+                   }
+                   runtime::print(")");
+                 }
+               #endif
+
+                 explicit mapped_lines(var const & o, const char * p, const char * e) :
+                   owner(o), pos(p), end(e), length(line_length(p, e)) { }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return runtime::make_cell(x, var(this));
+                 }
+
+                 var first() const final {
+                   size_t l = length;
+                   if (l > 0 && pos[l - 1] == '\r')
+                     l--;
+                   return obj<string_slice>(owner, pos, l);
+                 }
+
+                 var rest() const final {
+                   const char * next = pos + length + 1;
+                   if (next >= end)
+                     return cached::empty_sequence;
+                   return obj<mapped_lines>(owner, next, end);
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   const char * p = pos;
+                   while (p < end){
+                     size_t l = line_length(p, end);
+                     size_t n = l;
+                     if (n > 0 && p[n - 1] == '\r')
+                       n--;
+                     if (!rf.step(acc, obj<string_slice>(owner, p, n)))
+                       return false;
+                     p += l + 1;
+                   }
+                   return true;
+                 }
+               };
+
+               var mapped_file::lines(){
+                 if (_size == 0)
+                   return cached::empty_sequence;
+                 return obj<mapped_lines>(var(this), _data, _data + _size);
+               }
+
+               namespace runtime {
+                 // nil when the file can not be opened or mapped.
+                 inline var mmap_file(const char * path) {
+                   var f = obj<mapped_file>(path);
+                   if (f.cast<mapped_file>()->data() == nullptr)
+                     return nil();
+                   return f;
+                 }
+               }
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_TRANSDUCER
+               #define FERRET_OBJECT_TRANSDUCER
+                 namespace runtime {
+                   namespace type {
+                      const size_t transducer = 3975;}}
+
+               // Terminal step calling a two argument reducing lambda.
+               class fn_reducer final : public reducer_i {
+                 var const & fn;
+               public:
+                 explicit fn_reducer(var const & f) : fn(f) { }
+
+                 bool step(var & acc, var const & x) final {
+                   acc = runtime::apply(fn, runtime::list(acc, x));
+                   return true;
+                 }
+               };
+
+               #ifdef FERRET_STD_LIB
+               // A chain of map / filter / take / partition_all stages. Applied
+               // to a reducing step it becomes a single fused loop over the
+               // source, no intermediate sequence is built between stages.
+               class transducer final : public object {
+               public:
+                 enum kind { map_stage, filter_stage, take_stage, partition_all_stage };
+
+                 struct stage{
+                   kind what;
+                   var fn;
+                   size_t n;
+                 };
+
+               private:
+                 ::std::vector<stage> stages;
+
+                 class map_step final : public reducer_i {
+                   var const & fn;
+                   reducer_i & next;
+                 public:
+                   map_step(var const & f, reducer_i & n) : fn(f), next(n) { }
+                   bool step(var & acc, var const & x) final {
+                     return next.step(acc, runtime::apply(fn, runtime::list(x)));
+                   }
+                   void complete(var & acc) final { next.complete(acc); }
+                 };
+
+                 class filter_step final : public reducer_i {
+                   var const & fn;
+                   reducer_i & next;
+                 public:
+                   filter_step(var const & f, reducer_i & n) : fn(f), next(n) { }
+                   bool step(var & acc, var const & x) final {
+                     if (runtime::apply(fn, runtime::list(x)))
+                       return next.step(acc, x);
+                     return true;
+                   }
+                   void complete(var & acc) final { next.complete(acc); }
+                 };
+
+                 class take_step final : public reducer_i {
+                   size_t remaining;
+                   reducer_i & next;
+                 public:
+                   take_step(size_t n, reducer_i & r) : remaining(n), next(r) { }
+                   bool step(var & acc, var const & x) final {
+                     if (remaining == 0)
+                       return false;
+                     remaining--;
+                     return next.step(acc, x) && (remaining != 0);
+                   }
+                   void complete(var & acc) final { next.complete(acc); }
+                 };
+
+                 class partition_all_step final : public reducer_i {
+                   size_t n;
+                   reducer_i & next;
+                   std_vector chunk;
+                   bool stopped;
+
+                   var flush(){
+                     var ret;
+                     for(size_t i = chunk.size(); i > 0; i--)
+                       ret = runtime::make_cell(chunk[i - 1], ret);
+                     chunk.clear();
+                     return ret;
+                   }
+                 public:
+                   partition_all_step(size_t s, reducer_i & r) : n(s), next(r), stopped(false) {
+                     chunk.reserve(n);
+                   }
+                   bool step(var & acc, var const & x) final {
+                     chunk.push_back(x);
+                     if (chunk.size() < n)
+                       return true;
+                     stopped = !next.step(acc, flush());
+                     return !stopped;
+                   }
+                   void complete(var & acc) final {
+                     if (!stopped && !chunk.empty())
+                       next.step(acc, flush());
+                     next.complete(acc);
+                   }
+                 };
+
+               public:
+
+                 size_t type() const final { return runtime::type::transducer; }
+
+                 bool equals(var const & o) const final {
+                   return (this == o.get());
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("transducer<");
+                   runtime::print(stages.size());
+                   runtime::print(">");
+                 }
+               #endif
+
+                 explicit transducer(kind k, var const & f, size_t n = 0) {
+                   stages.push_back(stage{k, f, n});
+                 }
+
+                 // Stages of a run first.
+                 explicit transducer(var const & a, var const & b) {
+                   stages = a.cast<transducer>()->stages;
+                   for(auto const& s : b.cast<transducer>()->stages)
+                     stages.push_back(s);
+                 }
+
+                 static var map(var const & f) { return obj<transducer>(map_stage, f); }
+                 static var filter(var const & f) { return obj<transducer>(filter_stage, f); }
+                 static var take(size_t n) { return obj<transducer>(take_stage, nil(), n); }
+                 static var partition_all(size_t n) { return obj<transducer>(partition_all_stage, nil(), n); }
+                 static var comp(var const & a, var const & b) { return obj<transducer>(a, b); }
+
+                 // Reduce coll through the stages into rf, then complete.
+                 void transduce(reducer_i & rf, var & acc, var const & coll) const {
+                   ::std::vector<::std::unique_ptr<reducer_i>> chain;
+                   reducer_i * next = &rf;
+                   for(size_t i = stages.size(); i > 0; i--){
+                     stage const & s = stages[i - 1];
+                     switch(s.what){
+                     case map_stage:
+                       chain.emplace_back(new map_step(s.fn, *next)); break;
+                     case filter_stage:
+                       chain.emplace_back(new filter_step(s.fn, *next)); break;
+                     case take_stage:
+                       chain.emplace_back(new take_step(s.n, *next)); break;
+                     case partition_all_stage:
+                       chain.emplace_back(new partition_all_step(s.n, *next)); break;
+                     }
+                     next = chain.back().get();
+                   }
+
+                   bool take_nothing = false;
+                   for(auto const& s : stages)
+                     if (s.what == take_stage && s.n == 0)
+                       take_nothing = true;
+
+                   if (!take_nothing)
+                     runtime::reduce(*next, acc, coll);
+                   next->complete(acc);
+                 }
+               };
+
+               namespace runtime {
+                 inline var transduce(var const & xform, var const & f, var const & init, var const & coll) {
+                   var acc = init;
+                   fn_reducer rf(f);
+                   xform.cast<transducer>()->transduce(rf, acc, coll);
+                   return acc;
+                 }
+
+                 // Eagerly collect the transformed elements, in source order.
+                 inline var into(var const & xform, var const & coll) {
+                   class collect final : public reducer_i {
+                   public:
+                     std_vector items;
+                     bool step(var &, var const & x) final {
+                       items.push_back(x);
+                       return true;
+                     }
+                   } rf;
+
+                   var acc;
+                   xform.cast<transducer>()->transduce(rf, acc, coll);
+
+                   var ret;
+                   for(size_t i = rf.items.size(); i > 0; i--)
+                     ret = runtime::make_cell(rf.items[i - 1], ret);
+                   return ret;
+                 }
+               }
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_FOLD
+               #define FERRET_OBJECT_FOLD
+
+               #ifdef FERRET_STD_LIB
+               #if !defined(FERRET_FOLD_GRAIN)
+                 # define FERRET_FOLD_GRAIN 512
+               #endif
+
+               #if !defined(FERRET_DISABLE_MULTI_THREADING)
+               #if !defined(FERRET_WORKER_THREADS)
+                 # define FERRET_WORKER_THREADS ::std::thread::hardware_concurrency()
+               #endif
+
+               namespace runtime {
+                 // Fixed set of worker threads shared by the data parallel
+                 // operations. Threads waiting on a batch help run queued
+                 // tasks, so nested folds cannot starve the pool.
+                 class thread_pool{
+                   ::std::mutex lock;
+                   ::std::condition_variable available;
+                   ::std::deque<::std::function<void()>> tasks;
+                   ::std::vector<::std::thread> workers;
+                   bool stopping;
+
+                   void work(){
+                     for(;;){
+                       ::std::function<void()> task;
+                       {
+                         ::std::unique_lock<::std::mutex> guard(lock);
+                         available.wait(guard, [this]{ return stopping || !tasks.empty(); });
+                         if (tasks.empty())
+                           return;
+                         task = ::std::move(tasks.front());
+                         tasks.pop_front();
+                       }
+                       task();
+                     }
+                   }
+
+                 public:
+                   explicit thread_pool(size_t n) : stopping(false) {
+                     if (n == 0)
+                       n = 1;
+                     for(size_t i = 0; i < n; i++)
+                       workers.push_back(::std::thread([this]{ work(); }));
+                   }
+
+                   ~thread_pool(){
+                     {
+                       ::std::lock_guard<::std::mutex> guard(lock);
+                       stopping = true;
+                     }
+                     available.notify_all();
+                     for(auto & w : workers)
+                       w.join();
+                   }
+
+                   size_t size() const { return workers.size(); }
+
+                   void submit(::std::function<void()> task){
+                     {
+                       ::std::lock_guard<::std::mutex> guard(lock);
+                       tasks.push_back(::std::move(task));
+                     }
+                     available.notify_one();
+                   }
+
+                   bool run_one(){
+                     ::std::function<void()> task;
+                     {
+                       ::std::lock_guard<::std::mutex> guard(lock);
+                       if (tasks.empty())
+                         return false;
+                       task = ::std::move(tasks.front());
+                       tasks.pop_front();
+                     }
+                     task();
+                     return true;
+                   }
+
+                   static thread_pool & shared(){
+                     static thread_pool pool(FERRET_WORKER_THREADS);
+                     return pool;
+                   }
+                 };
+
+                 // Runs a batch of tasks on the shared pool and waits for all
+                 // of them, rethrowing the first exception raised.
+                 class task_group{
+                   ::std::mutex lock;
+                   ::std::condition_variable done;
+                   size_t pending;
+                   ::std::exception_ptr error;
+
+                 public:
+                   task_group() : pending(0) { }
+
+                   void run(::std::function<void()> task){
+                     {
+                       ::std::lock_guard<::std::mutex> guard(lock);
+                       pending++;
+                     }
+                     thread_pool::shared().submit([this, task]{
+                         try {
+                           task();
+                         } catch (...) {
+                           ::std::lock_guard<::std::mutex> guard(lock);
+                           if (!error)
+                             error = ::std::current_exception();
+                         }
+                         ::std::lock_guard<::std::mutex> guard(lock);
+                         if (--pending == 0)
+                           done.notify_all();
+                       });
+                   }
+
+                   // Helps with queued tasks while there are any, then
+                   // sleeps until the last task of the group is done. Every
+                   // waiter drains the queue before it sleeps, so a task it
+                   // depends on is always running somewhere.
+                   void wait(){
+                     while (thread_pool::shared().run_one()){
+                       ::std::lock_guard<::std::mutex> guard(lock);
+                       if (pending == 0)
+                         break;
+                     }
+                     ::std::unique_lock<::std::mutex> guard(lock);
+                     done.wait(guard, [this]{ return pending == 0; });
+                     if (error)
+                       ::std::rethrow_exception(error);
+                   }
+                 };
+               }
+               #endif
+
+               namespace runtime {
+                 // Where every chunk of grain elements of coll starts, the
+                 // elements themselves are not copied. Counted collections
+                 // step with nthrest, which jumps over integer ranges, the
+                 // rest are walked once.
+                 inline std_vector chunk_starts(var const & coll, size_t grain, size_t & size) {
+                   std_vector starts;
+                   size = 0;
+                   size_t n;
+                   if (known_count(coll, n)){
+                     var it = coll;
+                     for(size_t i = 0; i < n; i += grain){
+                       starts.push_back(it);
+                       if (i + grain < n)
+                         it = runtime::nthrest(it, (number_t)grain);
+                     }
+                     size = n;
+                     return starts;
+                   }
+
+                   var it = range_start(coll);
+                   while (!it.is_nil() && !it.is_type(type::empty_sequence)){
+                     starts.push_back(it);
+                     size_t i = 0;
+                     for(; i < grain && !it.is_nil() && !it.is_type(type::empty_sequence); i++)
+                       it = runtime::rest(it);
+                     size += i;
+                   }
+                   return starts;
+                 }
+
+                 // Passes on at most n elements, a chunk of a collection
+                 // reduced from one of its chunk_starts.
+                 class chunk_reducer final : public reducer_i {
+                   reducer_i & next;
+                   size_t left;
+                 public:
+                   chunk_reducer(reducer_i & r, size_t n) : next(r), left(n) { }
+                   bool step(var & acc, var const & x) final {
+                     return next.step(acc, x) && (--left != 0);
+                   }
+                 };
+
+                 template <typename F>
+                 inline void parallel_chunks(size_t size, size_t grain, F const & fn) {
+                   if (grain == 0)
+                     grain = 1;
+               #if !defined(FERRET_DISABLE_MULTI_THREADING)
+                   if (size > grain){
+                     task_group group;
+                     for(size_t begin = 0; begin < size; begin += grain){
+                       size_t end = runtime::min(begin + grain, size);
+                       group.run([&fn, begin, end]{ fn(begin, end); });
+                     }
+                     group.wait();
+                     return;
+                   }
+               #endif
+                   fn((size_t)0, size);
+                 }
+
+                 // Reduce chunks of grain elements in parallel, each starting
+                 // from (combinef), then merge the partial results in order
+                 // with (combinef left right).
+                 inline var fold(var const & coll, size_t grain, var const & combinef, var const & reducef) {
+                   if (grain == 0)
+                     grain = 1;
+                   size_t size;
+                   std_vector starts = chunk_starts(coll, grain, size);
+                   if (starts.empty())
+                     return run(combinef);
+
+                   std_vector partials(starts.size());
+                   parallel_chunks(starts.size(), 1, [&](size_t begin, size_t end){
+                       for(size_t c = begin; c < end; c++){
+                         var acc = run(combinef);
+                         fn_reducer rf(reducef);
+                         chunk_reducer chunk(rf, runtime::min(grain, size - c * grain));
+                         runtime::reduce(chunk, acc, starts[c]);
+                         partials[c] = acc;
+                       }
+                     });
+
+                   var ret = partials[0];
+                   for(size_t i = 1; i < partials.size(); i++)
+                     ret = runtime::apply(combinef, runtime::list(ret, partials[i]));
+                   return ret;
+                 }
+
+                 inline var fold(var const & coll, var const & combinef, var const & reducef) {
+                   return fold(coll, FERRET_FOLD_GRAIN, combinef, reducef);
+                 }
+
+                 // Like map but f is applied to chunks of grain elements on
+                 // the worker pool. The result keeps the order of coll.
+                 inline var pmap(var const & f, var const & coll, size_t grain = FERRET_FOLD_GRAIN) {
+                   class apply final : public reducer_i {
+                     var const & fn;
+                     var * out;
+                   public:
+                     apply(var const & f, var * o) : fn(f), out(o) { }
+                     bool step(var &, var const & x) final {
+                       *out++ = runtime::apply(fn, runtime::list(x));
+                       return true;
+                     }
+                   };
+
+                   if (grain == 0)
+                     grain = 1;
+                   size_t size;
+                   std_vector starts = chunk_starts(coll, grain, size);
+                   std_vector results(size);
+                   parallel_chunks(starts.size(), 1, [&](size_t begin, size_t end){
+                       for(size_t c = begin; c < end; c++){
+                         apply rf(f, &results[c * grain]);
+                         chunk_reducer chunk(rf, runtime::min(grain, size - c * grain));
+                         var acc;
+                         runtime::reduce(chunk, acc, starts[c]);
+                       }
+                     });
+
+                   var ret;
+                   for(size_t i = results.size(); i > 0; i--)
+                     ret = runtime::make_cell(results[i - 1], ret);
+                   return ret;
+                 }
+               }
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_TASK
+               #define FERRET_OBJECT_TASK
+                 namespace runtime {
+                   namespace type {
+                      const size_t task = 3977;}}
+
+               #if defined(FERRET_STD_LIB) && !defined(FERRET_DISABLE_MULTI_THREADING)
+               class task;
+
+               namespace runtime {
+                 // Wakes parked threads and green tasks. A waiter registers,
+                 // samples the epoch, re-checks its condition and only then
+                 // sleeps until the epoch moves, so a state change cannot slip
+                 // past it. Tasks are suspended instead of blocking their
+                 // scheduler thread.
+                 class signal{
+                   ::std::atomic<int> waiting;
+                   ::std::atomic<unsigned> epoch;
+                   ::std::mutex lock;
+                   ::std::condition_variable cv;
+                   // Parked tasks and the tickets of their waits.
+                   ::std::vector<::std::pair<task*, size_t>> tasks;
+                 public:
+                   signal() : waiting(0), epoch(0) { }
+
+                   void notify();
+
+                   template <typename F>
+                   void wait_until(F const & done);
+
+                   // As above, false when deadline passed first.
+                   template <typename F>
+                   bool wait_until(F const & done, ::std::chrono::steady_clock::time_point deadline);
+                 };
+               }
+
+               #if defined(FERRET_POSIX)
+               #if !defined(FERRET_GREEN_THREADS)
+                 # define FERRET_GREEN_THREADS ::std::thread::hardware_concurrency()
+               #endif
+
+               #if !defined(FERRET_TASK_STACK_SIZE)
+                 # define FERRET_TASK_STACK_SIZE 64_KB
+               #endif
+
+               // Green task, a stackful coroutine multiplexed with other
+               // tasks over a small set of scheduler threads. Spawning costs
+               // a stack mapping instead of an OS thread. Waiting on a
+               // channel, on another task or in runtime::sleep from inside a
+               // task suspends the task and frees its thread.
+               class task final : public deref_i {
+                 enum { running, parking, parked, notified };
+
+                 var fn;
+                 var value;
+                 ::std::exception_ptr error;
+                 ::std::atomic<bool> finished;
+                 // The low two bits hold the state above, the rest the
+                 // ticket of the wait in progress.
+                 ::std::atomic<size_t> state;
+                 runtime::signal completed;
+                 ucontext_t context;
+                 char * stack;
+               #if defined(FERRET_ENABLE_TRACE)
+                 // Trace scopes open while the task is off a thread.
+                 ::std::vector<trace::frame> scopes;
+               #endif
+
+                 static void entry();
+
+                 // Runs on the scheduler thread once the task switched out.
+                 void suspended();
+
+               public:
+
+                 class scheduler;
+
+                 static task * & current(){
+                   static thread_local task * t = nullptr;
+                   return t;
+                 }
+
+                 static ucontext_t * & home(){
+                   static thread_local ucontext_t * c = nullptr;
+                   return c;
+                 }
+
+                 size_t type() const final { return runtime::type::task; }
+
+                 bool equals(var const & o) const final {
+                   return (this == o.get());
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("task<");
+                   fn.stream_console();
+                   runtime::print(">");
+                 }
+               #endif
+
+                 explicit task(var const & f);
+
+                 ~task();
+
+                 // Hands the task to the scheduler, see obj<task>.
+                 void start();
+
+                 bool is_ready() const { return finished.load(::std::memory_order_acquire); }
+
+                 static size_t ticket_of(size_t s){ return s >> 2; }
+
+                 static size_t with(size_t ticket, size_t s){ return (ticket << 2) | s; }
+
+                 // Starts a new wait and returns its ticket. Whoever is to
+                 // wake the task is handed the ticket, wakes carrying the
+                 // ticket of an earlier wait, a timer or signal the task
+                 // stopped waiting on, are ignored.
+                 size_t prepare(){
+                   size_t ticket = (ticket_of(state.load()) + 1) & (~(size_t)0 >> 2);
+                   state.store(with(ticket, running));
+                   return ticket;
+                 }
+
+                 // Suspends the calling task until woken with the ticket of
+                 // the current wait. A wake that arrives first is kept and
+                 // makes park return at once.
+                 void park(){
+                   size_t s = state.load();
+                   for(;;){
+                     size_t ticket = ticket_of(s);
+                     if ((s & 3) == notified){
+                       if (state.compare_exchange_weak(s, with(ticket, running)))
+                         return;
+                     }else if (state.compare_exchange_weak(s, with(ticket, parking))){
+                       break;
+                     }
+                   }
+                   swapcontext(&context, home());
+                 }
+
+                 void wake(size_t ticket);
+
+                 // Lets other tasks run, on a plain thread yields the thread.
+                 static void yield(){
+                   task * self = current();
+                   if (self == nullptr){
+                     ::std::this_thread::yield();
+                     return;
+                   }
+                   self->state.store(with(ticket_of(self->state.load()), notified));
+                   swapcontext(&self->context, home());
+                 }
+
+                 var deref() {
+                   completed.wait_until([this]{ return is_ready(); });
+                   if (error)
+                     ::std::rethrow_exception(error);
+                   return value;
+                 }
+
+                 var deref(number_t ms, var const & timeout_val) {
+                   auto deadline = ::std::chrono::steady_clock::now() + ::std::chrono::milliseconds(ms);
+                   if (!completed.wait_until([this]{ return is_ready(); }, deadline))
+                     return timeout_val;
+                   return deref();
+                 }
+               };
+
+               class task::scheduler{
+                 typedef ::std::chrono::steady_clock clock;
+
+                 // Holds a reference, the task may have stopped waiting
+                 // and finished by the time the timer goes off.
+                 struct timer{
+                   clock::time_point at;
+                   task * t;
+                   size_t ticket;
+
+                   bool operator>(timer const & o) const { return at > o.at; }
+                 };
+
+                 ::std::mutex lock;
+                 ::std::condition_variable available;
+                 ::std::deque<task*> ready;
+                 ::std::priority_queue<timer, ::std::vector<timer>, ::std::greater<timer>> timers;
+                 ::std::vector<::std::thread> workers;
+                 bool stopping;
+                 ::std::mutex stack_lock;
+                 ::std::vector<char*> stacks;
+
+                 void work(){
+                   ucontext_t context;
+                   home() = &context;
+                   ::std::vector<timer> expired;
+                   for(;;){
+                     task * next = nullptr;
+                     {
+                       ::std::unique_lock<::std::mutex> guard(lock);
+                       for(;;){
+                         while (!timers.empty() && timers.top().at <= clock::now()){
+                           expired.push_back(timers.top());
+                           timers.pop();
+                         }
+                         if (!expired.empty() || !ready.empty())
+                           break;
+                         if (stopping)
+                           return;
+                         if (timers.empty())
+                           available.wait(guard);
+                         else
+                           available.wait_until(guard, timers.top().at);
+                       }
+                       if (expired.empty()){
+                         next = ready.front();
+                         ready.pop_front();
+                       }
+                     }
+
+                     if (next == nullptr){
+                       for(auto & e : expired){
+                         e.t->wake(e.ticket);
+                         if (e.t->dec_ref())
+                           delete e.t;
+                       }
+                       expired.clear();
+                       continue;
+                     }
+
+                     current() = next;
+               #if defined(FERRET_ENABLE_TRACE)
+                     trace::buffer & trace = trace::local();
+                     size_t base = trace.depth;
+                     trace.resume(next->scopes);
+               #endif
+                     swapcontext(&context, &next->context);
+                     current() = nullptr;
+               #if defined(FERRET_ENABLE_TRACE)
+                     trace.suspend(base, next->scopes);
+               #endif
+                     next->suspended();
+                   }
+                 }
+
+               public:
+                 explicit scheduler(size_t n) : stopping(false) {
+                   if (n == 0)
+                     n = 1;
+                   for(size_t i = 0; i < n; i++)
+                     workers.push_back(::std::thread([this]{ work(); }));
+                 }
+
+                 ~scheduler(){
+                   {
+                     ::std::lock_guard<::std::mutex> guard(lock);
+                     stopping = true;
+                   }
+                   available.notify_all();
+                   for(auto & w : workers)
+                     w.join();
+                   for(auto s : stacks)
+                     munmap(s, stack_size());
+                 }
+
+                 static size_t stack_size(){
+                   static size_t size = (size_t)(FERRET_TASK_STACK_SIZE + sysconf(_SC_PAGESIZE));
+                   return size;
+                 }
+
+                 // Stacks of finished tasks are kept for reuse, mapping a
+                 // fresh one costs more than the rest of a spawn.
+                 char * acquire_stack(){
+                   {
+                     ::std::lock_guard<::std::mutex> guard(stack_lock);
+                     if (!stacks.empty()){
+                       char * s = stacks.back();
+                       stacks.pop_back();
+                       return s;
+                     }
+                   }
+                   void * mem = mmap(nullptr, stack_size(), PROT_READ | PROT_WRITE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                   if (mem == MAP_FAILED)
+                     throw ::std::bad_alloc();
+                   // Guard page, an overflow faults instead of corrupting.
+                   mprotect(mem, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE);
+                   return (char *)mem;
+                 }
+
+                 void release_stack(char * s){
+                   {
+                     ::std::lock_guard<::std::mutex> guard(stack_lock);
+                     if (stacks.size() < 256){
+                       stacks.push_back(s);
+                       return;
+                     }
+                   }
+                   munmap(s, stack_size());
+                 }
+
+                 void enqueue(task * t){
+                   {
+                     ::std::lock_guard<::std::mutex> guard(lock);
+                     ready.push_back(t);
+                   }
+                   available.notify_one();
+                 }
+
+                 void wake_at(clock::time_point deadline, task * t, size_t ticket){
+                   t->inc_ref();
+                   {
+                     ::std::lock_guard<::std::mutex> guard(lock);
+                     timers.push(timer{deadline, t, ticket});
+                   }
+                   available.notify_all();
+                 }
+
+                 static scheduler & shared(){
+                   static scheduler instance(FERRET_GREEN_THREADS);
+                   return instance;
+                 }
+               };
+
+               inline task::task(var const & f) :
+                 fn(f), value(nil()), finished(false), state(running) {
+                 size_t page = (size_t)sysconf(_SC_PAGESIZE);
+                 stack = scheduler::shared().acquire_stack();
+
+                 getcontext(&context);
+                 context.uc_stack.ss_sp = stack + page;
+                 context.uc_stack.ss_size = scheduler::stack_size() - page;
+                 context.uc_link = nullptr;
+                 makecontext(&context, entry, 0);
+               }
+
+               inline void task::start(){
+                 // Reference held by the scheduler until the task finishes.
+                 inc_ref();
+                 scheduler::shared().enqueue(this);
+               }
+
+               // A task may finish before its constructor returns, so it is
+               // only started once the caller holds a reference.
+               template <>
+               inline var obj<task>(var f) {
+                 void * storage = FERRET_ALLOCATOR::allocate<task>();
+                 var t(new(storage) task(f));
+                 t.cast<task>()->start();
+                 return t;
+               }
+
+               inline task::~task(){
+                 if (stack != nullptr)
+                   scheduler::shared().release_stack(stack);
+               }
+
+               inline void task::entry(){
+                 task * self = current();
+                 try{
+                   self->value = run(self->fn);
+                 }catch(...){
+                   self->error = ::std::current_exception();
+                 }
+                 self->finished.store(true, ::std::memory_order_release);
+                 self->completed.notify();
+                 setcontext(home());
+               }
+
+               inline void task::suspended(){
+                 if (is_ready()){
+                   scheduler::shared().release_stack(stack);
+                   stack = nullptr;
+                   if (dec_ref())
+                     delete this;
+                   return;
+                 }
+
+                 size_t s = state.load();
+                 for(;;){
+                   size_t ticket = ticket_of(s);
+                   if ((s & 3) == parking){
+                     if (state.compare_exchange_weak(s, with(ticket, parked)))
+                       return;
+                   }else{
+                     // Woken or yielded before it got off the thread.
+                     state.store(with(ticket, running));
+                     scheduler::shared().enqueue(this);
+                     return;
+                   }
+                 }
+               }
+
+               inline void task::wake(size_t ticket){
+                 size_t s = state.load();
+                 for(;;){
+                   if (ticket_of(s) != ticket || (s & 3) == notified)
+                     return;
+                   if ((s & 3) == parked){
+                     if (state.compare_exchange_weak(s, with(ticket, running))){
+                       scheduler::shared().enqueue(this);
+                       return;
+                     }
+                   }else if (state.compare_exchange_weak(s, with(ticket, notified))){
+                     return;
+                   }
+                 }
+               }
+               #endif
+
+               inline void runtime::signal::notify(){
+                 ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+                 if (waiting.load(::std::memory_order_relaxed) == 0)
+                   return;
+                 {
+                   ::std::lock_guard<::std::mutex> guard(lock);
+                   epoch++;
+               #if defined(FERRET_POSIX)
+                   // Under the lock, a task that stopped waiting takes its
+                   // entry out under it before it can finish.
+                   for(auto const & t : tasks)
+                     t.first->wake(t.second);
+               #endif
+                   tasks.clear();
+                 }
+                 cv.notify_all();
+               }
+
+               template <typename F>
+               void runtime::signal::wait_until(F const & done){
+                 waiting++;
+                 ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+               #if defined(FERRET_POSIX)
+                 task * self = task::current();
+               #endif
+                 for(;;){
+                   unsigned seen = epoch.load();
+                   if (done())
+                     break;
+               #if defined(FERRET_POSIX)
+                   if (self != nullptr){
+                     size_t ticket = self->prepare();
+                     {
+                       ::std::lock_guard<::std::mutex> guard(lock);
+                       if (epoch.load() != seen)
+                         continue;
+                       tasks.push_back(::std::make_pair(self, ticket));
+                     }
+                     self->park();
+                     continue;
+                   }
+               #endif
+                   ::std::unique_lock<::std::mutex> guard(lock);
+                   cv.wait(guard, [this, seen]{ return epoch.load() != seen; });
+                 }
+                 waiting--;
+               }
+
+               namespace runtime {
+                 // Inside a task only the task sleeps, its thread keeps
+                 // running other tasks.
+                 inline void sleep(number_t ms) {
+               #if defined(FERRET_POSIX)
+                   task * self = task::current();
+                   if (self != nullptr){
+                     size_t ticket = self->prepare();
+                     task::scheduler::shared().wake_at(::std::chrono::steady_clock::now() +
+                                                       ::std::chrono::milliseconds(ms), self, ticket);
+                     self->park();
+                     return;
+                   }
+               #endif
+                   ::std::this_thread::sleep_for(::std::chrono::milliseconds(ms));
+                 }
+
+                 inline void yield() {
+               #if defined(FERRET_POSIX)
+                   task::yield();
+               #else
+                   ::std::this_thread::yield();
+               #endif
+                 }
+               }
+
+               template <typename F>
+               bool runtime::signal::wait_until(F const & done, ::std::chrono::steady_clock::time_point deadline){
+                 waiting++;
+                 ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+               #if defined(FERRET_POSIX)
+                 task * self = task::current();
+               #endif
+                 bool ok;
+                 for(;;){
+                   unsigned seen = epoch.load();
+                   if ((ok = done()))
+                     break;
+               #if defined(FERRET_POSIX)
+                   // Parked on both the signal and a timer under one ticket,
+                   // the one that fires second finds a later ticket or none
+                   // and is ignored.
+                   if (self != nullptr){
+                     if (::std::chrono::steady_clock::now() >= deadline)
+                       break;
+                     size_t ticket = self->prepare();
+                     {
+                       ::std::lock_guard<::std::mutex> guard(lock);
+                       if (epoch.load() != seen)
+                         continue;
+                       tasks.push_back(::std::make_pair(self, ticket));
+                     }
+                     task::scheduler::shared().wake_at(deadline, self, ticket);
+                     self->park();
+                     ::std::lock_guard<::std::mutex> guard(lock);
+                     for(size_t i = 0; i < tasks.size(); i++)
+                       if (tasks[i].first == self && tasks[i].second == ticket){
+                         tasks.erase(tasks.begin() + i);
+                         break;
+                       }
+                     continue;
+                   }
+               #endif
+                   ::std::unique_lock<::std::mutex> guard(lock);
+                   if (!cv.wait_until(guard, deadline, [this, seen]{ return epoch.load() != seen; })){
+                     ok = done();
+                     break;
+                   }
+                 }
+                 waiting--;
+                 return ok;
+               }
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_CHANNEL
+               #define FERRET_OBJECT_CHANNEL
+                 namespace runtime {
+                   namespace type {
+                      const size_t channel = 3976;}}
+
+               #if defined(FERRET_STD_LIB) && !defined(FERRET_DISABLE_MULTI_THREADING)
+               // Bounded multi producer / multi consumer queue. The ring is
+               // the lock free sequence number scheme by Dmitry Vyukov, the
+               // mutex and condition variables are only touched by threads
+               // that have to park on a full or empty channel.
+               //
+               // The ring is a power of two, at least two, but puts are
+               // counted against the exact capacity. A channel of capacity
+               // zero is unbuffered, a put only goes through while a taker
+               // is waiting for it.
+               //
+               // Parked putters and takers wait on separate lists and each
+               // put or take wakes one of the other side. Invoked with no
+               // arguments a channel takes, with one it puts.
+               class channel final : public lambda_i {
+                 struct cell{
+                   ::std::atomic<size_t> sequence;
+                   var data;
+                 };
+
+                 cell * buffer;
+                 size_t mask;
+                 size_t bound;
+                 char pad_0[64];
+                 ::std::atomic<size_t> enqueue_pos;
+                 char pad_1[64];
+                 ::std::atomic<size_t> dequeue_pos;
+                 char pad_2[64];
+                 ::std::atomic<size_t> used;
+                 ::std::atomic<size_t> takers;
+                 ::std::atomic<bool> closed;
+
+               public:
+
+                 class wait_list;
+
+                 // A parked put, take or alts. An alts waiter is linked into
+                 // the lists of every channel it selects over and the first
+                 // of them to wake it wins, the others pass it by.
+                 class waiter{
+                   ::std::atomic<wait_list*> woken;
+               #if defined(FERRET_POSIX)
+                   task * self;
+                   size_t ticket;
+               #endif
+                   ::std::mutex lock;
+                   ::std::condition_variable cv;
+
+                 public:
+                   waiter() : woken(nullptr) {
+               #if defined(FERRET_POSIX)
+                     self = task::current();
+                     ticket = 0;
+               #endif
+                   }
+
+                   // Called before linking it again.
+                   void reset(){
+                     woken.store(nullptr);
+               #if defined(FERRET_POSIX)
+                     if (self != nullptr)
+                       ticket = self->prepare();
+               #endif
+                   }
+
+                   wait_list * woken_by() const { return woken.load(); }
+
+                   // Under the lock of the list l, false when another list
+                   // woke it first.
+                   bool wake(wait_list * l){
+                     wait_list * none = nullptr;
+                     if (!woken.compare_exchange_strong(none, l))
+                       return false;
+               #if defined(FERRET_POSIX)
+                     if (self != nullptr){
+                       self->wake(ticket);
+                       return true;
+                     }
+               #endif
+                     ::std::lock_guard<::std::mutex> guard(lock);
+                     cv.notify_one();
+                     return true;
+                   }
+
+                   void wait(){
+               #if defined(FERRET_POSIX)
+                     if (self != nullptr){
+                       while (woken.load() == nullptr)
+                         self->park();
+                       return;
+                     }
+               #endif
+                     ::std::unique_lock<::std::mutex> guard(lock);
+                     cv.wait(guard, [this]{ return woken.load() != nullptr; });
+                   }
+                 };
+
+                 // Entry of a waiter in one list.
+                 struct link{
+                   waiter * w;
+                   wait_list * list;
+                   link * prev;
+                   link * next;
+                 };
+
+                 // Waiters parked on one side of a channel, woken in the
+                 // order they came. Wakers that find it empty do not lock.
+                 class wait_list{
+                   ::std::mutex lock;
+                   link head;
+                   ::std::atomic<size_t> parked;
+
+                   void unlink(link * l){
+                     l->prev->next = l->next;
+                     l->next->prev = l->prev;
+                     l->prev = l->next = nullptr;
+                     parked.fetch_sub(1, ::std::memory_order_relaxed);
+                   }
+
+                   // Wakes the first one it can, all of them when all is set.
+                   void wake(bool all){
+                     ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+                     if (parked.load(::std::memory_order_relaxed) == 0)
+                       return;
+                     ::std::lock_guard<::std::mutex> guard(lock);
+                     while (head.next != &head){
+                       link * l = head.next;
+                       unlink(l);
+                       if (l->w->wake(this) && !all)
+                         return;
+                     }
+                   }
+
+                 public:
+                   wait_list() : parked(0) {
+                     head.w = nullptr;
+                     head.list = this;
+                     head.prev = head.next = &head;
+                   }
+
+                   // The caller checks its condition again after this, a
+                   // wake issued after that check finds it linked.
+                   void add(link & l, waiter & w){
+                     l.w = &w;
+                     l.list = this;
+                     ::std::lock_guard<::std::mutex> guard(lock);
+                     l.prev = head.prev;
+                     l.next = &head;
+                     head.prev->next = &l;
+                     head.prev = &l;
+                     parked.fetch_add(1, ::std::memory_order_seq_cst);
+                   }
+
+                   // Once the links of a waiter are removed no list can
+                   // wake it any more, it may then go away.
+                   void remove(link & l){
+                     ::std::lock_guard<::std::mutex> guard(lock);
+                     if (l.next != nullptr)
+                       unlink(&l);
+                   }
+
+                   void wake_one(){ wake(false); }
+
+                   void wake_all(){ wake(true); }
+                 };
+
+               private:
+
+                 wait_list not_full;
+                 wait_list not_empty;
+
+                 // Spins a little, then parks on list until ready() or the
+                 // channel is closed.
+                 template <typename F>
+                 bool park(wait_list & list, F const & ready){
+                   for(int spin = 0; spin < 64; spin++){
+                     if (ready())
+                       return true;
+                     runtime::yield();
+                   }
+
+                   waiter w;
+                   link l;
+                   for(;;){
+                     w.reset();
+                     list.add(l, w);
+                     bool ok = ready();
+                     if (ok || closed.load(::std::memory_order_acquire)){
+                       list.remove(l);
+                       return ok;
+                     }
+                     w.wait();
+                     list.remove(l);
+                   }
+                 }
+
+               public:
+
+                 size_t type() const final { return runtime::type::channel; }
+
+                 bool equals(var const & o) const final {
+                   return (this == o.get());
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("channel<");
+                   runtime::print(bound);
+                   runtime::print(">");
+                 }
+               #endif
+
+                 explicit channel(size_t capacity = 1) :
+                   bound(capacity), enqueue_pos(0), dequeue_pos(0),
+                   used(0), takers(0), closed(false) {
+                   size_t size = 2;
+                   while (size < capacity)
+                     size *= 2;
+                   mask = size - 1;
+                   buffer = new cell[size];
+                   for(size_t i = 0; i < size; i++)
+                     buffer[i].sequence.store(i, ::std::memory_order_relaxed);
+                 }
+
+                 ~channel(){ delete[] buffer; }
+
+                 size_t capacity() const { return bound; }
+
+                 // Waiting takers let puts through an unbuffered channel,
+                 // take and alts register while they wait.
+                 void wait_take(){
+                   takers.fetch_add(1, ::std::memory_order_acq_rel);
+                   if (bound == 0)
+                     not_full.wake_one();
+                 }
+
+                 void done_take(){
+                   takers.fetch_sub(1, ::std::memory_order_acq_rel);
+                 }
+
+                 bool is_closed() const { return closed.load(::std::memory_order_acquire); }
+
+                 void close(){
+                   closed.store(true, ::std::memory_order_release);
+                   not_full.wake_all();
+                   not_empty.wake_all();
+                 }
+
+                 // List a put or take on this channel parks on.
+                 wait_list & waiters(bool put){ return put ? not_full : not_empty; }
+
+                 // False when the channel is full or closed.
+                 bool try_put(var const & x){
+                   if (closed.load(::std::memory_order_acquire))
+                     return false;
+
+                   size_t limit = bound;
+                   if (limit == 0)
+                     limit = runtime::min(takers.load(::std::memory_order_acquire), mask + 1);
+                   size_t n = used.load(::std::memory_order_relaxed);
+                   do{
+                     if (n >= limit)
+                       return false;
+                   }while(!used.compare_exchange_weak(n, n + 1, ::std::memory_order_acq_rel));
+
+                   // The slot is reserved, it can only still be held by a
+                   // taker that is moving its value out.
+                   size_t pos = enqueue_pos.load(::std::memory_order_relaxed);
+                   for(;;){
+                     cell & c = buffer[pos & mask];
+                     size_t seq = c.sequence.load(::std::memory_order_acquire);
+                     intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+                     if (dif == 0){
+                       if (enqueue_pos.compare_exchange_weak(pos, pos + 1, ::std::memory_order_relaxed)){
+                         c.data = x;
+                         c.sequence.store(pos + 1, ::std::memory_order_release);
+                         not_empty.wake_one();
+                         return true;
+                       }
+                     }else if (dif < 0){
+                       runtime::yield();
+                       pos = enqueue_pos.load(::std::memory_order_relaxed);
+                     }else{
+                       pos = enqueue_pos.load(::std::memory_order_relaxed);
+                     }
+                   }
+                 }
+
+                 // False when the channel is empty.
+                 bool try_take(var & x){
+                   size_t pos = dequeue_pos.load(::std::memory_order_relaxed);
+                   for(;;){
+                     cell & c = buffer[pos & mask];
+                     size_t seq = c.sequence.load(::std::memory_order_acquire);
+                     intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+                     if (dif == 0){
+                       if (dequeue_pos.compare_exchange_weak(pos, pos + 1, ::std::memory_order_relaxed)){
+                         x = ::std::move(c.data);
+                         c.sequence.store(pos + mask + 1, ::std::memory_order_release);
+                         used.fetch_sub(1, ::std::memory_order_acq_rel);
+                         not_full.wake_one();
+                         return true;
+                       }
+                     }else if (dif < 0){
+                       return false;
+                     }else{
+                       pos = dequeue_pos.load(::std::memory_order_relaxed);
+                     }
+                   }
+                 }
+
+                 // Blocks while full, false once the channel is closed.
+                 bool put(var const & x){
+                   return park(not_full, [this, &x]{ return try_put(x); });
+                 }
+
+                 // Blocks while empty, nil once closed and drained.
+                 var take(){
+                   var x;
+                   if (try_take(x))
+                     return x;
+                   wait_take();
+                   if (!park(not_empty, [this, &x]{ return try_take(x); }))
+                     try_take(x);
+                   done_take();
+                   return x;
+                 }
+
+                 var deref() {
+                   return take();
+                 }
+
+                 // (ch) takes, (ch x) puts and yields whether it went in.
+                 var invoke(var const & args) const final {
+                   channel * self = const_cast<channel*>(this);
+                   if (args.is_nil() || args.is_type(runtime::type::empty_sequence))
+                     return self->take();
+                   return self->put(runtime::first(args)) ? cached::true_t : cached::false_t;
+                 }
+               };
+
+               namespace runtime {
+                 // ops is a sequence of channels to take from and (channel
+                 // value) pairs to put. Blocks until one completes and returns
+                 // (value channel); puts yield true or false as the value.
+                 // With wait false returns nil instead of blocking.
+                 inline var alts(var const & ops, bool wait = true) {
+                   std_vector list;
+                   for(auto const& op : runtime::range(ops))
+                     list.push_back(op);
+                   if (list.empty())
+                     return nil();
+
+                   static ::std::atomic<size_t> rotate(0);
+                   size_t start = rotate++;
+
+                   // Sets done to the wait list of the side that completed.
+                   auto attempt = [&list, start](var & ret, channel::wait_list * & done) -> bool {
+                     for(size_t n = 0; n < list.size(); n++){
+                       var const & op = list[(start + n) % list.size()];
+                       if (op.is_type(runtime::type::channel)){
+                         channel * ch = op.cast<channel>();
+                         var x;
+                         if (ch->try_take(x) || ch->is_closed()){
+                           ret = runtime::list(x, op);
+                           done = &ch->waiters(false);
+                           return true;
+                         }
+                       }else{
+                         var target = runtime::first(op);
+                         channel * ch = target.cast<channel>();
+                         done = &ch->waiters(true);
+                         if (ch->is_closed()){
+                           ret = runtime::list(cached::false_t, target);
+                           return true;
+                         }
+                         if (ch->try_put(runtime::first(runtime::rest(op)))){
+                           ret = runtime::list(cached::true_t, target);
+                           return true;
+                         }
+                       }
+                     }
+                     return false;
+                   };
+
+                   var ret;
+                   channel::wait_list * done = nullptr;
+                   if (attempt(ret, done) || !wait)
+                     return ret;
+
+                   // Parks on the side of each channel an op waits for.
+                   ::std::vector<channel::link> links(list.size());
+                   channel::waiter w;
+                   for(auto const& op : list)
+                     if (op.is_type(runtime::type::channel))
+                       op.cast<channel>()->wait_take();
+                   for(;;){
+                     w.reset();
+                     for(size_t i = 0; i < list.size(); i++){
+                       bool put = !list[i].is_type(runtime::type::channel);
+                       var target = put ? runtime::first(list[i]) : list[i];
+                       target.cast<channel>()->waiters(put).add(links[i], w);
+                     }
+                     bool ok = attempt(ret, done);
+                     if (!ok)
+                       w.wait();
+                     for(auto & l : links)
+                       l.list->remove(l);
+                     if (ok || attempt(ret, done))
+                       break;
+                   }
+                   for(auto const& op : list)
+                     if (op.is_type(runtime::type::channel))
+                       op.cast<channel>()->done_take();
+
+                   // Woken by a channel it did not complete on, the wake is
+                   // handed to the next waiter there.
+                   channel::wait_list * by = w.woken_by();
+                   if (by != nullptr && by != done)
+                     by->wake_one();
+                   return ret;
+                 }
+               }
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_TIMER_WHEEL
+               #define FERRET_OBJECT_TIMER_WHEEL
+                 namespace runtime {
+                   namespace type {
+                      const size_t timer_wheel = 3978;}}
+
+               #if defined(FERRET_STD_LIB)
+               #if !defined(FERRET_TIMER_RESOLUTION)
+                 # define FERRET_TIMER_RESOLUTION 100
+               #endif
+
+               // Runs periodic and one shot lambdas at their deadlines instead
+               // of polling elapsed_micros in a busy loop. Timers live in a
+               // four level hierarchical wheel, 64 slots per level and
+               // FERRET_TIMER_RESOLUTION microseconds per tick, so adding,
+               // cancelling and expiring a timer is O(1). Between deadlines
+               // the runner sleeps until the next occupied slot.
+               //
+               // Deadlines are absolute, a periodic timer does not drift with
+               // the time its lambda takes. Periods missed because a lambda
+               // ran long are skipped and counted as overruns. Jitter is the
+               // lateness of each start in microseconds. A lambda that throws
+               // retires its timer and the exception leaves run.
+               class timer_wheel final : public object {
+                 struct entry{
+                   size_t id;
+                   var fn;
+                   uint64_t period;
+                   uint64_t deadline;
+                   bool cancelled;
+                   ::std::atomic<bool> running;
+                   uint64_t runs;
+                   uint64_t overruns;
+                   uint64_t jitter_last;
+                   uint64_t jitter_max;
+                   uint64_t jitter_total;
+
+                   entry(size_t i, var const & f, uint64_t p, uint64_t d) :
+                     id(i), fn(f), period(p), deadline(d), cancelled(false), running(false),
+                     runs(0), overruns(0), jitter_last(0), jitter_max(0), jitter_total(0) { }
+                 };
+                 typedef ::std::shared_ptr<entry> entry_ptr;
+
+                 static const unsigned bits = 6;
+                 static const unsigned slots = 1 << bits;
+                 static const unsigned levels = 4;
+
+                 ::std::vector<entry_ptr> wheel[levels][slots];
+                 ::std::unordered_map<size_t, entry_ptr> timers;
+                 size_t next_id;
+                 uint64_t resolution;
+                 uint64_t tick;
+                 size_t active;
+                 bool pooled;
+                 ::std::atomic<bool> stopping;
+                 ::std::exception_ptr error;
+                 mutex lock;
+               #if !defined(FERRET_DISABLE_MULTI_THREADING)
+                 ::std::mutex wait_lock;
+                 ::std::condition_variable changed;
+                 uint64_t generation;
+               #endif
+
+                 static uint64_t now(){
+               #if defined(__linux__)
+                   timespec ts;
+                   clock_gettime(CLOCK_MONOTONIC, &ts);
+                   return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+               #else
+                   auto epoch = ::std::chrono::steady_clock::now().time_since_epoch();
+                   return (uint64_t)::std::chrono::duration_cast<::std::chrono::microseconds>(epoch).count();
+               #endif
+                 }
+
+                 // Sleeps until the absolute time at, or until a timer is
+                 // added from another thread. Returns false when woken early.
+                 bool sleep_until(uint64_t at){
+               #if !defined(FERRET_DISABLE_MULTI_THREADING)
+                   ::std::unique_lock<::std::mutex> guard(wait_lock);
+                   uint64_t seen = generation;
+                   auto deadline = ::std::chrono::steady_clock::now() +
+                     ::std::chrono::microseconds(at - ::std::min(at, now()));
+                   return !changed.wait_until(guard, deadline, [this, seen]{
+                       return generation != seen || stopping.load(); });
+               #elif defined(__linux__)
+                   timespec ts;
+                   ts.tv_sec = (time_t)(at / 1000000);
+                   ts.tv_nsec = (long)(at % 1000000) * 1000;
+                   while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+                   return true;
+               #else
+                   ::std::this_thread::sleep_for(::std::chrono::microseconds(at - ::std::min(at, now())));
+                   return true;
+               #endif
+                 }
+
+                 void changed_timers(){
+               #if !defined(FERRET_DISABLE_MULTI_THREADING)
+                   {
+                     ::std::lock_guard<::std::mutex> guard(wait_lock);
+                     generation++;
+                   }
+                   changed.notify_all();
+               #endif
+                 }
+
+                 void schedule(entry_ptr const & e){
+                   uint64_t expires = (e->deadline + resolution - 1) / resolution;
+                   if (expires <= tick)
+                     expires = tick + 1;
+
+                   uint64_t delta = expires - tick;
+                   uint64_t span = (uint64_t)1 << (bits * levels);
+                   if (delta >= span)
+                     expires = tick + span - 1;
+
+                   unsigned level = 0;
+                   while (level < levels - 1 && delta >= ((uint64_t)1 << (bits * (level + 1))))
+                     level++;
+                   wheel[level][(expires >> (bits * level)) & (slots - 1)].push_back(e);
+                 }
+
+                 // First tick at which an occupied slot is either due or
+                 // cascades into a lower level.
+                 uint64_t next_tick() const {
+                   uint64_t next = UINT64_MAX;
+                   for(unsigned level = 0; level < levels; level++){
+                     uint64_t shift = bits * level;
+                     uint64_t base = (tick >> (shift + bits)) << (shift + bits);
+                     for(unsigned slot = 0; slot < slots; slot++){
+                       if (wheel[level][slot].empty())
+                         continue;
+                       uint64_t at = base + ((uint64_t)slot << shift);
+                       if (at <= tick)
+                         at += (uint64_t)1 << (shift + bits);
+                       next = ::std::min(next, at);
+                     }
+                   }
+                   return next;
+                 }
+
+                 void cascade(unsigned level){
+                   ::std::vector<entry_ptr> list;
+                   list.swap(wheel[level][(tick >> (bits * level)) & (slots - 1)]);
+                   for(auto const & e : list)
+                     if (!e->cancelled)
+                       schedule(e);
+                 }
+
+                 void advance(uint64_t target, ::std::vector<entry_ptr> & due){
+                   while (tick < target){
+                     tick++;
+                     for(unsigned level = 1; level < levels; level++){
+                       if ((tick & (((uint64_t)1 << (bits * level)) - 1)) != 0)
+                         break;
+                       cascade(level);
+                     }
+
+                     ::std::vector<entry_ptr> list;
+                     list.swap(wheel[0][tick & (slots - 1)]);
+                     for(auto const & e : list){
+                       if (e->cancelled)
+                         continue;
+                       if ((e->deadline + resolution - 1) / resolution > tick)
+                         schedule(e);
+                       else
+                         due.push_back(e);
+                     }
+                   }
+                 }
+
+                 // Entries may still sit in a wheel slot, they are dropped
+                 // there once their slot comes up.
+                 void retire(entry_ptr const & e){
+                   if (e->cancelled)
+                     return;
+                   e->cancelled = true;
+                   active--;
+                   timers.erase(e->id);
+                 }
+
+                 void finish(entry_ptr const & e, uint64_t at){
+                   if (e->period == 0 || e->cancelled){
+                     retire(e);
+                     return;
+                   }
+
+                   uint64_t next = e->deadline + e->period;
+                   if (next <= at){
+                     uint64_t missed = (at - e->deadline) / e->period;
+                     e->overruns += missed;
+                     next = e->deadline + (missed + 1) * e->period;
+                   }
+                   e->deadline = next;
+                   schedule(e);
+                 }
+
+                 static void started(entry & e, uint64_t at){
+                   uint64_t jitter = at > e.deadline ? at - e.deadline : 0;
+                   e.runs++;
+                   e.jitter_last = jitter;
+                   e.jitter_max = ::std::max(e.jitter_max, jitter);
+                   e.jitter_total += jitter;
+                 }
+
+                 void fire(entry_ptr const & e){
+                   uint64_t start = now();
+                   {
+                     lock_guard guard(lock);
+                     if (e->cancelled)
+                       return;
+               #if !defined(FERRET_DISABLE_MULTI_THREADING)
+                     if (pooled){
+                       if (e->running.exchange(true)){
+                         e->overruns++;
+                       }else{
+                         started(*e, start);
+                         entry_ptr job = e;
+                         var self(this);
+                         runtime::thread_pool::shared().submit([self, job]{
+                             timer_wheel * wheel = self.cast<timer_wheel>();
+                             try{
+                               ferret::run(job->fn);
+                             }catch(...){
+                               lock_guard guard(wheel->lock);
+                               if (!wheel->error)
+                                 wheel->error = ::std::current_exception();
+                               wheel->retire(job);
+                             }
+                             job->running.store(false);
+                             wheel->changed_timers();
+                           });
+                       }
+                       finish(e, start);
+                       return;
+                     }
+               #endif
+                     started(*e, start);
+                   }
+
+                   try{
+                     ferret::run(e->fn);
+                   }catch(...){
+                     lock_guard guard(lock);
+                     retire(e);
+                     throw;
+                   }
+                   lock_guard guard(lock);
+                   finish(e, now());
+                 }
+
+                 size_t add(var const & f, uint64_t period, uint64_t delay){
+                   size_t id;
+                   {
+                     lock_guard guard(lock);
+                     id = next_id++;
+                     entry_ptr e(new entry(id, f, period, now() + delay));
+                     timers[id] = e;
+                     schedule(e);
+                     active++;
+                   }
+                   changed_timers();
+                   return id;
+                 }
+
+               public:
+
+                 size_t type() const final { return runtime::type::timer_wheel; }
+
+                 bool equals(var const & o) const final {
+                   return (this == o.get());
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("timer_wheel<");
+                   runtime::print(active);
+                   runtime::print(">");
+                 }
+               #endif
+
+                 // With pooled set lambdas run on the shared worker pool, a
+                 // lambda still running at its next deadline is skipped and
+                 // counted as an overrun.
+                 explicit timer_wheel(bool pool = false,
+                                      uint64_t res = FERRET_TIMER_RESOLUTION) :
+                   next_id(0), resolution(res == 0 ? 1 : res), active(0), pooled(pool), stopping(false) {
+                   tick = now() / resolution;
+               #if !defined(FERRET_DISABLE_MULTI_THREADING)
+                   generation = 0;
+               #endif
+                 }
+
+                 // Times are in microseconds, the first run of a periodic
+                 // timer is delay after registration.
+                 size_t every(var const & f, uint64_t period, uint64_t delay = 0) {
+                   return add(f, (period == 0 ? 1 : period), delay);
+                 }
+
+                 size_t after(var const & f, uint64_t delay) {
+                   return add(f, 0, delay);
+                 }
+
+                 bool cancel(size_t id) {
+                   lock_guard guard(lock);
+                   auto it = timers.find(id);
+                   if (it == timers.end())
+                     return false;
+                   retire(it->second);
+                   return true;
+                 }
+
+                 void stop() {
+                   stopping.store(true);
+                   changed_timers();
+                 }
+
+                 // Runs timers on the calling thread until stop is called, no
+                 // timers are left or duration microseconds have passed.
+                 void run(uint64_t duration = 0) {
+               #if defined(__linux__)
+                   // Default timer slack adds up to 50us to every wakeup, the
+                   // caller's slack is put back when run returns.
+                   struct slack{
+                     int previous;
+                     slack() : previous(prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0)) {
+                       prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+                     }
+                     ~slack(){
+                       if (previous > 0)
+                         prctl(PR_SET_TIMERSLACK, (unsigned long)previous, 0, 0, 0);
+                     }
+                   } timer_slack;
+               #endif
+                   uint64_t until = (duration == 0) ? UINT64_MAX : now() + duration;
+                   // Longest sleep, the span of the wheel. Bounds the wait when
+                   // no slot is occupied, e.g. while pooled lambdas run.
+                   uint64_t longest = ((uint64_t)1 << (bits * levels)) * resolution;
+                   stopping.store(false);
+                   ::std::vector<entry_ptr> due;
+
+                   while (!stopping.load()){
+                     uint64_t at;
+                     {
+                       lock_guard guard(lock);
+                       if (error){
+                         ::std::exception_ptr e = error;
+                         error = nullptr;
+                         ::std::rethrow_exception(e);
+                       }
+                       if (active == 0)
+                         break;
+                       uint64_t next = next_tick();
+                       at = (next == UINT64_MAX) ? until : ::std::min(until, next * resolution);
+                       uint64_t t = now();
+                       if (at > t && at - t > longest)
+                         at = t + longest;
+                     }
+
+                     if (now() < at && !sleep_until(at))
+                       continue;
+                     if (now() >= until)
+                       break;
+
+                     {
+                       lock_guard guard(lock);
+                       advance(now() / resolution, due);
+                     }
+                     for(auto const & e : due)
+                       fire(e);
+                     due.clear();
+                   }
+                 }
+
+                 // (runs overruns jitter-last jitter-max jitter-mean), nil for
+                 // unknown, cancelled and finished ids.
+                 var stats(size_t id) {
+                   lock_guard guard(lock);
+                   auto it = timers.find(id);
+                   if (it == timers.end())
+                     return nil();
+                   entry const & e = *it->second;
+                   return runtime::list(obj<number>((real_t)e.runs),
+                                        obj<number>((real_t)e.overruns),
+                                        obj<number>((real_t)e.jitter_last),
+                                        obj<number>((real_t)e.jitter_max),
+                                        obj<number>(e.runs == 0 ? 0 : (real_t)e.jitter_total / (real_t)e.runs));
+                 }
+               };
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_PROMISE
+               #define FERRET_OBJECT_PROMISE
+                 namespace runtime {
+                   namespace type {
+                      const size_t promise = 3979;}}
+
+               #if defined(FERRET_STD_LIB) && !defined(FERRET_DISABLE_MULTI_THREADING)
+               // Single assignment value that any thread may deliver. State
+               // and continuation list are atomics, is_ready is one acquire
+               // load and registering a continuation one CAS. Blocked derefs
+               // park on a signal, from a green task only the task waits.
+               class promise final : public deref_i {
+                 enum { pending, delivering, delivered };
+
+                 struct callback{
+                   ::std::function<void()> fn;
+                   callback * next;
+                 };
+
+                 static callback * closed(){
+                   static callback sentinel;
+                   return &sentinel;
+                 }
+
+                 ::std::atomic<int> state;
+                 ::std::atomic<callback*> callbacks;
+                 var value;
+                 ::std::exception_ptr error;
+                 runtime::signal completed;
+
+                 bool complete(var const & v, ::std::exception_ptr e){
+                   int expected = pending;
+                   if (!state.compare_exchange_strong(expected, delivering))
+                     return false;
+                   value = v;
+                   error = e;
+                   state.store(delivered, ::std::memory_order_release);
+                   completed.notify();
+
+                   // Run in registration order.
+                   callback * list = callbacks.exchange(closed());
+                   callback * ordered = nullptr;
+                   while (list != nullptr){
+                     callback * next = list->next;
+                     list->next = ordered;
+                     ordered = list;
+                     list = next;
+                   }
+                   while (ordered != nullptr){
+                     callback * next = ordered->next;
+                     ordered->fn();
+                     delete ordered;
+                     ordered = next;
+                   }
+                   return true;
+                 }
+
+               public:
+
+                 size_t type() const final { return runtime::type::promise; }
+
+                 bool equals(var const & o) const final {
+                   return (this == o.get());
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("promise<");
+                   if (is_ready() && !error)
+                     value.stream_console();
+                   else
+                     runtime::print(is_ready() ? "failed" : "pending");
+                   runtime::print(">");
+                 }
+               #endif
+
+                 promise() : state(pending), callbacks(nullptr) { }
+
+                 ~promise(){
+                   callback * list = callbacks.load();
+                   while (list != nullptr && list != closed()){
+                     callback * next = list->next;
+                     delete list;
+                     list = next;
+                   }
+                 }
+
+                 bool is_ready() const {
+                   return (state.load(::std::memory_order_acquire) == delivered);
+                 }
+
+                 bool is_failed() const {
+                   return (is_ready() && error);
+                 }
+
+                 // False when already delivered.
+                 bool deliver(var const & v) { return complete(v, nullptr); }
+
+                 bool fail(::std::exception_ptr e) { return complete(nil(), e); }
+
+                 // Runs fn on the delivering thread once delivered, right
+                 // away when it already is.
+                 void on_complete(::std::function<void()> fn){
+                   callback * node = new callback{fn, nullptr};
+                   callback * head = callbacks.load();
+                   do{
+                     if (head == closed()){
+                       delete node;
+                       fn();
+                       return;
+                     }
+                     node->next = head;
+                   }while (!callbacks.compare_exchange_weak(head, node));
+                 }
+
+                 var deref() {
+                   completed.wait_until([this]{ return is_ready(); });
+                   if (error)
+                     ::std::rethrow_exception(error);
+                   return value;
+                 }
+
+                 var deref(number_t ms, var const & timeout_val) {
+                   auto deadline = ::std::chrono::steady_clock::now() + ::std::chrono::milliseconds(ms);
+                   if (!completed.wait_until([this]{ return is_ready(); }, deadline))
+                     return timeout_val;
+                   return deref();
+                 }
+
+                 // Promise of (f value), computed on the shared worker pool.
+                 // A failure skips f and fails the returned promise. The
+                 // callback holds this promise by pointer, it only runs
+                 // while the promise completes, and holding a var would
+                 // keep an undelivered promise alive through its own
+                 // callback list.
+                 var then(var const & f) {
+                   promise * from = this;
+                   var next = obj<promise>();
+                   on_complete([from, next, f]{
+                       promise * to = next.cast<promise>();
+                       if (from->error){
+                         to->fail(from->error);
+                         return;
+                       }
+                       var self(from);
+                       runtime::thread_pool::shared().submit([self, next, f]{
+                           try{
+                             next.cast<promise>()->deliver(runtime::apply(f, runtime::list(self.cast<promise>()->value)));
+                           }catch(...){
+                             next.cast<promise>()->fail(::std::current_exception());
+                           }
+                         });
+                     });
+                   return next;
+                 }
+               };
+
+               namespace runtime {
+                 // Promise of the list of values of the promises in coll, in
+                 // order. Fails with the first failure. Other values count
+                 // as delivered. Pending promises are not kept in the shared
+                 // state, their callbacks hold it, and callbacks see their
+                 // promise by pointer only.
+                 inline var when_all(var const & coll) {
+                   struct state{
+                     std_vector values;
+                     ::std::atomic<size_t> remaining;
+                     var result;
+                   };
+
+                   std_vector inputs = sequence::to<std_vector>(coll);
+                   auto all = ::std::make_shared<state>();
+                   all->values.resize(inputs.size());
+                   all->remaining.store(inputs.size() + 1);
+                   all->result = obj<promise>();
+
+                   auto arrived = [all]{
+                     if (--all->remaining == 0){
+                       var ret;
+                       for(size_t i = all->values.size(); i > 0; i--)
+                         ret = runtime::make_cell(all->values[i - 1], ret);
+                       all->result.cast<promise>()->deliver(ret);
+                     }
+                   };
+
+                   for(size_t i = 0; i < inputs.size(); i++){
+                     var const & x = inputs[i];
+                     if (x.is_nil() || !x.is_type(type::promise)){
+                       all->values[i] = x;
+                       arrived();
+                       continue;
+                     }
+                     promise * p = x.cast<promise>();
+                     p->on_complete([all, i, p, arrived]{
+                         if (p->is_failed()){
+                           try{
+                             p->deref();
+                           }catch(...){
+                             all->result.cast<promise>()->fail(::std::current_exception());
+                           }
+                           return;
+                         }
+                         all->values[i] = p->deref();
+                         arrived();
+                       });
+                   }
+                   arrived();
+                   return all->result;
+                 }
+
+                 // Promise of the first value delivered by a promise in
+                 // coll, or its failure.
+                 inline var when_any(var const & coll) {
+                   var result = obj<promise>();
+                   for(auto const& x : runtime::range(coll)){
+                     if (x.is_nil() || !x.is_type(type::promise)){
+                       result.cast<promise>()->deliver(x);
+                       break;
+                     }
+                     promise * p = x.cast<promise>();
+                     p->on_complete([result, p]{
+                         try{
+                           result.cast<promise>()->deliver(p->deref());
+                         }catch(...){
+                           result.cast<promise>()->fail(::std::current_exception());
+                         }
+                       });
+                   }
+                   return result;
+                 }
+               }
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_SORTED_MAP
+               #define FERRET_OBJECT_SORTED_MAP
+                 namespace runtime {
+                   namespace type {
+                      const size_t sorted_node = 3980;
+                      const size_t sorted_map = 3981;
+                      const size_t sorted_set = 3982;
+                      const size_t sorted_seq = 3983;}}
+
+               #if defined(FERRET_STD_LIB)
+               #if !defined(FERRET_SORTED_ORDER)
+                 # define FERRET_SORTED_ORDER 32
+               #endif
+
+               namespace runtime {
+                 // Natural order, used when a sorted collection has no
+                 // comparator. nil sorts first, numbers and keywords by
+                 // value, sequential collections lexicographically, anything
+                 // else by type and then identity. Numbers within epsilon
+                 // compare equal, as they do with equals.
+                 inline int compare(var const & a, var const & b) {
+                   if (a.get() == b.get())
+                     return 0;
+                   if (a.is_nil())
+                     return -1;
+                   if (b.is_nil())
+                     return 1;
+
+                   size_t ta = a.get()->type();
+                   size_t tb = b.get()->type();
+
+                   if (ta == type::number && tb == type::number){
+                     real_t x = a.cast<number>()->word();
+                     real_t y = b.cast<number>()->word();
+                     if (runtime::abs(x - y) < real_epsilon)
+                       return 0;
+                     return (x < y) ? -1 : 1;
+                   }
+
+                   if (ta == type::keyword && tb == type::keyword){
+                     number_t x = a.cast<keyword>()->word();
+                     number_t y = b.cast<keyword>()->word();
+                     return (x < y) ? -1 : (x > y ? 1 : 0);
+                   }
+
+                   if (is_seqable(a) && is_seqable(b)){
+                     var x = a;
+                     var y = b;
+                     for(;;){
+                       bool x_end = x.is_nil() || x.is_type(type::empty_sequence);
+                       bool y_end = y.is_nil() || y.is_type(type::empty_sequence);
+                       if (x_end || y_end)
+                         return (x_end && y_end) ? 0 : (x_end ? -1 : 1);
+                       int c = compare(first(x), first(y));
+                       if (c != 0)
+                         return c;
+                       x = rest(x);
+                       y = rest(y);
+                     }
+                   }
+
+                   if (ta != tb)
+                     return (ta < tb) ? -1 : 1;
+                   if (a == b)
+                     return 0;
+                   return (a.get() < b.get()) ? -1 : 1;
+                 }
+               }
+
+               // Comparator of a sorted collection. A lambda may return a
+               // number, negative zero or positive like compare, or a
+               // boolean less than, which costs a second call on ties.
+               class sorted_order{
+                 var fn;
+               public:
+                 explicit sorted_order(var const & f = nil()) : fn(f) { }
+
+                 var const & function() const { return fn; }
+
+                 int operator()(var const & a, var const & b) const {
+                   if (fn.is_nil())
+                     return runtime::compare(a, b);
+
+                   var r = runtime::apply(fn, runtime::list(a, b));
+                   if (!r.is_nil() && r.is_type(runtime::type::number)){
+                     real_t c = number::to<real_t>(r);
+                     return (c < 0) ? -1 : (c > 0 ? 1 : 0);
+                   }
+                   if (r)
+                     return -1;
+                   return runtime::apply(fn, runtime::list(b, a)) ? 1 : 0;
+                 }
+               };
+
+               // B+tree node. Every entry of an inner node is the smallest
+               // key below a child and the child itself, so inner and leaf
+               // nodes split and merge the same way. Nodes are never
+               // changed once shared, updates copy the path from the root.
+               class sorted_node final : public object {
+               public:
+                 size_t size;
+                 bool leaf;
+                 var keys[FERRET_SORTED_ORDER];
+                 var vals[FERRET_SORTED_ORDER];
+
+                 size_t type() const final { return runtime::type::sorted_node; }
+
+                 bool equals(var const & o) const final {
+                   return (this == o.get());
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("sorted_node<");
+                   runtime::print(size);
+                   runtime::print(">");
+                 }
+               #endif
+
+                 explicit sorted_node(bool l) : size(0), leaf(l) { }
+
+                 sorted_node * child(size_t i) const { return vals[i].cast<sorted_node>(); }
+               };
+
+               namespace sorted_tree {
+                 const size_t order = FERRET_SORTED_ORDER;
+                 const size_t minimum = FERRET_SORTED_ORDER / 2;
+                 const size_t max_depth = 24;
+
+                 struct split{
+                   var left;
+                   var right;
+                 };
+
+                 // First index whose key is not less than k.
+                 inline size_t lower_bound(sorted_node const * n, var const & k, sorted_order const & cmp){
+                   size_t lo = 0;
+                   size_t hi = n->size;
+                   while (lo < hi){
+                     size_t mid = (lo + hi) / 2;
+                     if (cmp(n->keys[mid], k) < 0)
+                       lo = mid + 1;
+                     else
+                       hi = mid;
+                   }
+                   return lo;
+                 }
+
+                 // Last child whose smallest key is not greater than k.
+                 inline size_t child_index(sorted_node const * n, var const & k, sorted_order const & cmp){
+                   size_t lo = 0;
+                   size_t hi = n->size;
+                   while (lo < hi){
+                     size_t mid = (lo + hi) / 2;
+                     if (cmp(n->keys[mid], k) <= 0)
+                       lo = mid + 1;
+                     else
+                       hi = mid;
+                   }
+                   return (lo == 0) ? 0 : lo - 1;
+                 }
+
+                 inline var make(bool leaf, var * keys, var * vals, size_t n){
+                   var node = obj<sorted_node>(leaf);
+                   sorted_node * m = node.cast<sorted_node>();
+                   for(size_t i = 0; i < n; i++){
+                     m->keys[i] = static_cast<var&&>(keys[i]);
+                     m->vals[i] = static_cast<var&&>(vals[i]);
+                   }
+                   m->size = n;
+                   return node;
+                 }
+
+                 inline var const & smallest(var const & node){
+                   return node.cast<sorted_node>()->keys[0];
+                 }
+
+                 // Tree of entries already in order with distinct keys,
+                 // built a level at a time from the leaves up. Entries are
+                 // spread evenly, so every node but a lone root is at least
+                 // half full. The vectors are consumed.
+                 inline var build(::std::vector<var> & keys, ::std::vector<var> & vals){
+                   bool leaf = true;
+                   for(;;){
+                     size_t n = keys.size();
+                     if (n == 0)
+                       return nil();
+                     size_t nodes = (n + order - 1) / order;
+                     ::std::vector<var> up_keys;
+                     ::std::vector<var> up_vals;
+                     up_keys.reserve(nodes);
+                     up_vals.reserve(nodes);
+                     size_t at = 0;
+                     for(size_t i = 0; i < nodes; i++){
+                       size_t take = n / nodes + ((i < n % nodes) ? 1 : 0);
+                       var node = make(leaf, &keys[at], &vals[at], take);
+                       at += take;
+                       up_keys.push_back(smallest(node));
+                       up_vals.push_back(node);
+                     }
+                     if (nodes == 1)
+                       return up_vals[0];
+                     keys.swap(up_keys);
+                     vals.swap(up_vals);
+                     leaf = false;
+                   }
+                 }
+
+                 // Fills one new node with n entries, or two halves when n
+                 // is over the order, straight from the old nodes.
+                 class builder{
+                   split parts;
+                   sorted_node * left;
+                   sorted_node * right;
+                   size_t half;
+                 public:
+                   builder(bool leaf, size_t n) : left(nullptr), right(nullptr), half(n) {
+                     parts.left = obj<sorted_node>(leaf);
+                     left = parts.left.cast<sorted_node>();
+                     if (n > order){
+                       half = n / 2;
+                       parts.right = obj<sorted_node>(leaf);
+                       right = parts.right.cast<sorted_node>();
+                     }
+                   }
+
+                   void push(var const & k, var const & v){
+                     sorted_node * n = (left->size < half) ? left : right;
+                     n->keys[n->size] = k;
+                     n->vals[n->size++] = v;
+                   }
+
+                   void push_child(var const & child){
+                     push(smallest(child), child);
+                   }
+
+                   split const & done() const { return parts; }
+                 };
+
+                 inline split insert(sorted_node const * n, var const & k, var const & v,
+                                     sorted_order const & cmp, bool & added){
+                   if (n->leaf){
+                     size_t at = lower_bound(n, k, cmp);
+                     added = !(at < n->size && cmp(n->keys[at], k) == 0);
+                     builder b(true, n->size + (added ? 1 : 0));
+                     for(size_t i = 0; i < at; i++)
+                       b.push(n->keys[i], n->vals[i]);
+                     b.push(k, v);
+                     for(size_t i = (added ? at : at + 1); i < n->size; i++)
+                       b.push(n->keys[i], n->vals[i]);
+                     return b.done();
+                   }
+
+                   size_t at = child_index(n, k, cmp);
+                   split below = insert(n->child(at), k, v, cmp, added);
+                   bool grew = !below.right.is_nil();
+                   builder b(false, n->size + (grew ? 1 : 0));
+                   for(size_t i = 0; i < n->size; i++){
+                     if (i != at){
+                       b.push(n->keys[i], n->vals[i]);
+                       continue;
+                     }
+                     b.push_child(below.left);
+                     if (grew)
+                       b.push_child(below.right);
+                   }
+                   return b.done();
+                 }
+
+                 // Returns the new node, possibly under filled or empty, or
+                 // nil when k is not in the tree.
+                 inline var remove(sorted_node const * n, var const & k, sorted_order const & cmp){
+                   if (n->leaf){
+                     size_t at = lower_bound(n, k, cmp);
+                     if (at == n->size || cmp(n->keys[at], k) != 0)
+                       return nil();
+                     builder b(true, n->size - 1);
+                     for(size_t i = 0; i < n->size; i++)
+                       if (i != at)
+                         b.push(n->keys[i], n->vals[i]);
+                     return b.done().left;
+                   }
+
+                   size_t at = child_index(n, k, cmp);
+                   var below = remove(n->child(at), k, cmp);
+                   if (below.is_nil())
+                     return nil();
+
+                   sorted_node const * c = below.cast<sorted_node>();
+                   if (c->size == 0){
+                     builder b(false, n->size - 1);
+                     for(size_t i = 0; i < n->size; i++)
+                       if (i != at)
+                         b.push(n->keys[i], n->vals[i]);
+                     return b.done().left;
+                   }
+
+                   if (c->size >= minimum || n->size == 1){
+                     builder b(false, n->size);
+                     for(size_t i = 0; i < n->size; i++)
+                       if (i != at)
+                         b.push(n->keys[i], n->vals[i]);
+                       else
+                         b.push_child(below);
+                     return b.done().left;
+                   }
+
+                   // Under filled, merge with a neighbour and split again if
+                   // the two do not fit in one node.
+                   size_t left = (at + 1 < n->size) ? at : at - 1;
+                   sorted_node const * l = (left == at) ? c : n->child(left);
+                   sorted_node const * r = (left == at) ? n->child(at + 1) : c;
+
+                   builder merged(c->leaf, l->size + r->size);
+                   for(size_t i = 0; i < l->size; i++)
+                     merged.push(l->keys[i], l->vals[i]);
+                   for(size_t i = 0; i < r->size; i++)
+                     merged.push(r->keys[i], r->vals[i]);
+                   split parts = merged.done();
+                   bool two = !parts.right.is_nil();
+
+                   builder b(false, n->size - (two ? 0 : 1));
+                   for(size_t i = 0; i < n->size; i++){
+                     if (i == left){
+                       b.push_child(parts.left);
+                       if (two)
+                         b.push_child(parts.right);
+                     }else if (i != left + 1){
+                       b.push(n->keys[i], n->vals[i]);
+                     }
+                   }
+                   return b.done().left;
+                 }
+
+                 // Leaf holding k and its index there, nullptr if absent.
+                 inline sorted_node const * find(var const & root, var const & k,
+                                                 sorted_order const & cmp, size_t & at){
+                   if (root.is_nil())
+                     return nullptr;
+                   sorted_node const * n = root.cast<sorted_node>();
+                   while (!n->leaf)
+                     n = n->child(child_index(n, k, cmp));
+                   at = lower_bound(n, k, cmp);
+                   if (at == n->size || cmp(n->keys[at], k) != 0)
+                     return nullptr;
+                   return n;
+                 }
+
+                 // Position in the leaves, kept as the path from the root.
+                 struct cursor{
+                   sorted_node const * path[max_depth];
+                   size_t index[max_depth];
+                   size_t depth;
+                   bool valid;
+
+                   cursor() : depth(0), valid(false) { }
+
+                   var const & key() const { return path[depth - 1]->keys[index[depth - 1]]; }
+                   var const & val() const { return path[depth - 1]->vals[index[depth - 1]]; }
+
+                   // Moves past exhausted nodes, then down to the leftmost
+                   // leaf entry below.
+                   void settle(size_t level){
+                     for(;;){
+                       if (index[level] < path[level]->size)
+                         break;
+                       if (level == 0){
+                         valid = false;
+                         return;
+                       }
+                       level--;
+                       index[level]++;
+                     }
+                     for(; level + 1 < depth; level++){
+                       path[level + 1] = path[level]->child(index[level]);
+                       index[level + 1] = 0;
+                     }
+                     valid = true;
+                   }
+
+                   void next(){
+                     index[depth - 1]++;
+                     settle(depth - 1);
+                   }
+
+                   void seek_first(var const & root){
+                     depth = 0;
+                     valid = false;
+                     if (root.is_nil())
+                       return;
+                     sorted_node const * n = root.cast<sorted_node>();
+                     for(;;){
+                       path[depth] = n;
+                       index[depth++] = 0;
+                       if (n->leaf)
+                         break;
+                       n = n->child(0);
+                     }
+                     settle(depth - 1);
+                   }
+
+                   // First entry not less than k, or greater than k.
+                   void seek(var const & root, var const & k, bool inclusive, sorted_order const & cmp){
+                     depth = 0;
+                     valid = false;
+                     if (root.is_nil())
+                       return;
+                     sorted_node const * n = root.cast<sorted_node>();
+                     while (!n->leaf){
+                       size_t at = child_index(n, k, cmp);
+                       path[depth] = n;
+                       index[depth++] = at;
+                       n = n->child(at);
+                     }
+                     size_t at = lower_bound(n, k, cmp);
+                     if (!inclusive && at < n->size && cmp(n->keys[at], k) == 0)
+                       at++;
+                     path[depth] = n;
+                     index[depth++] = at;
+                     settle(depth - 1);
+                   }
+                 };
+               }
+
+               // Ascending walk over part of a sorted map or set, a cursor
+               // into the shared tree rather than a list of its entries.
+               class sorted_seq final : public object, public seekable_i {
+                 var root;
+                 sorted_tree::cursor at;
+                 sorted_order cmp;
+                 var hi;
+                 bool bounded;
+                 bool hi_inclusive;
+                 bool set;
+
+                 var entry(sorted_tree::cursor const & c) const {
+                   if (set)
+                     return c.key();
+                   return runtime::list(c.key(), c.val());
+                 }
+
+               public:
+
+                 size_t type() const final { return runtime::type::sorted_seq; }
+
+                 bool equals(var const & o) const final {
+                   var other = o;
+                   for(sorted_tree::cursor c = at; in_range(c); c.next()){
+                     if (entry(c) != runtime::first(other))
+                       return false;
+                     other = runtime::rest(other);
+                   }
+                   return (other.is_nil() || other.is_type(runtime::type::empty_sequence));
+                 }
+
+                 size_t hash() const final { return runtime::hash_ordered(var((object*)this)); }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("(");
+                   for(sorted_tree::cursor c = at; in_range(c); c.next()){
+                     if (c.path[c.depth - 1] != at.path[at.depth - 1] ||
+                         c.index[c.depth - 1] != at.index[at.depth - 1])
+                       runtime::print(" ");
+                     entry(c).stream_console();
+                   }
+                   runtime::print(")");
+                 }
+               #endif
+
+                 sorted_seq(var const & r, sorted_tree::cursor const & c, sorted_order const & o,
+                            var const & h, bool b, bool inclusive, bool s) :
+                   root(r), at(c), cmp(o), hi(h), bounded(b), hi_inclusive(inclusive), set(s) { }
+
+                 bool in_range(sorted_tree::cursor const & c) const {
+                   if (!c.valid)
+                     return false;
+                   if (!bounded)
+                     return true;
+                   int d = cmp(c.key(), hi);
+                   return hi_inclusive ? (d <= 0) : (d < 0);
+                 }
+
+                 // nil when the cursor is already past the range.
+                 static var from(var const & root, sorted_tree::cursor const & c, sorted_order const & o,
+                                 var const & h, bool b, bool inclusive, bool s){
+                   var seq = obj<sorted_seq>(root, c, o, h, b, inclusive, s);
+                   if (!seq.cast<sorted_seq>()->in_range(c))
+                     return nil();
+                   return seq;
+                 }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return runtime::make_cell(x, var(this));
+                 }
+
+                 var first() const final {
+                   return entry(at);
+                 }
+
+                 var rest() const final {
+                   sorted_tree::cursor c = at;
+                   c.next();
+                   return from(root, c, cmp, hi, bounded, hi_inclusive, set);
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   for(sorted_tree::cursor c = at; in_range(c); c.next())
+                     if (!rf.step(acc, entry(c)))
+                       return false;
+                   return true;
+                 }
+               };
+
+               // Shared by sorted_map and sorted_set, the set keeps nil as
+               // every value.
+               class sorted_base{
+               protected:
+                 var root;
+                 size_t _count;
+                 sorted_order cmp;
+
+                 sorted_base(var const & r, size_t n, sorted_order const & o) :
+                   root(r), _count(n), cmp(o) { }
+
+                 bool with(var const & k, var const & v, var & new_root) const {
+                   bool added = true;
+                   if (root.is_nil()){
+                     var keys[1] = { k };
+                     var vals[1] = { v };
+                     new_root = sorted_tree::make(true, keys, vals, 1);
+                     return added;
+                   }
+                   sorted_tree::split s = sorted_tree::insert(root.cast<sorted_node>(), k, v, cmp, added);
+                   if (s.right.is_nil()){
+                     new_root = s.left;
+                   }else{
+                     var keys[2] = { sorted_tree::smallest(s.left), sorted_tree::smallest(s.right) };
+                     var vals[2] = { s.left, s.right };
+                     new_root = sorted_tree::make(false, keys, vals, 2);
+                   }
+                   return added;
+                 }
+
+                 bool without(var const & k, var & new_root) const {
+                   if (root.is_nil())
+                     return false;
+                   var r = sorted_tree::remove(root.cast<sorted_node>(), k, cmp);
+                   if (r.is_nil())
+                     return false;
+                   while (!r.is_nil()){
+                     sorted_node * n = r.cast<sorted_node>();
+                     if (n->size == 0){
+                       r = nil();
+                     }else if (!n->leaf && n->size == 1){
+                       var child = n->vals[0];
+                       r = child;
+                     }else{
+                       break;
+                     }
+                   }
+                   new_root = r;
+                   return true;
+                 }
+
+                 sorted_node const * lookup(var const & k, size_t & at) const {
+                   return sorted_tree::find(root, k, cmp, at);
+                 }
+
+                 var range(var const & lo, bool lo_inclusive, var const & hi, bool hi_inclusive,
+                           bool bounded_lo, bool bounded_hi, bool set) const {
+                   sorted_tree::cursor c;
+                   if (bounded_lo)
+                     c.seek(root, lo, lo_inclusive, cmp);
+                   else
+                     c.seek_first(root);
+                   return sorted_seq::from(root, c, cmp, hi, bounded_hi, hi_inclusive, set);
+                 }
+
+                 // Greatest entry not greater than k.
+                 bool floor_of(var const & k, sorted_tree::cursor & c) const {
+                   if (root.is_nil())
+                     return false;
+                   sorted_node const * n = root.cast<sorted_node>();
+                   if (cmp(n->keys[0], k) > 0)
+                     return false;
+                   c.depth = 0;
+                   while (!n->leaf){
+                     size_t at = sorted_tree::child_index(n, k, cmp);
+                     c.path[c.depth] = n;
+                     c.index[c.depth++] = at;
+                     n = n->child(at);
+                   }
+                   size_t at = sorted_tree::lower_bound(n, k, cmp);
+                   if (at == n->size || cmp(n->keys[at], k) != 0)
+                     at--;
+                   c.path[c.depth] = n;
+                   c.index[c.depth++] = at;
+                   c.valid = true;
+                   return true;
+                 }
+
+                 bool ceiling_of(var const & k, sorted_tree::cursor & c) const {
+                   c.seek(root, k, true, cmp);
+                   return c.valid;
+                 }
+
+               public:
+
+                 var comparator() const { return cmp.function(); }
+               };
+
+               class sorted_map final : public lambda_i, public seekable_i, public sorted_base {
+                 exact_hash_cache _hash;
+               public:
+
+                 size_t type() const final { return runtime::type::sorted_map; }
+
+                 bool equals(var const & o) const final {
+                   if (this == o.get())
+                     return true;
+                   if (!o.is_type(runtime::type::sorted_map))
+                     return false;
+                   sorted_map * other = o.cast<sorted_map>();
+                   if (_count != other->count())
+                     return false;
+                   if (_hash.differs(other->_hash))
+                     return false;
+                   sorted_tree::cursor c;
+                   for(c.seek_first(root); c.valid; c.next()){
+                     size_t at;
+                     sorted_node const * n = other->lookup(c.key(), at);
+                     if (n == nullptr || n->vals[at] != c.val())
+                       return false;
+                   }
+                   return true;
+                 }
+
+                 // Same as the hash of a d_list with these entries.
+                 size_t hash() const final {
+                   size_t h;
+                   if (_hash.get(h))
+                     return h;
+                   h = 0;
+                   bool exact = true;
+                   sorted_tree::cursor c;
+                   for(c.seek_first(root); c.valid; c.next()){
+                     h += runtime::hash_mix(runtime::hash(c.key()) * 31 + runtime::hash(c.val()));
+                     exact = exact && runtime::hash_exact(c.key()) && runtime::hash_exact(c.val());
+                   }
+                   _hash.set(h, exact);
+                   return h;
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("{");
+                   sorted_tree::cursor c;
+                   for(c.seek_first(root); c.valid; c.next()){
+                     c.key().stream_console();
+                     runtime::print(" ");
+                     c.val().stream_console();
+                     sorted_tree::cursor n = c;
+                     n.next();
+                     if (n.valid)
+                       runtime::print(", ");
+                   }
+                   runtime::print("}");
+                 }
+               #endif
+
+                 // comparator is nil for runtime::compare order.
+                 explicit sorted_map(var const & comparator = nil()) :
+                   sorted_base(nil(), 0, sorted_order(comparator)) { }
+
+                 sorted_map(var const & r, size_t n, sorted_order const & o) :
+                   sorted_base(r, n, o) { }
+
+                 bool counted(size_t & n) const final { n = count(); return true; }
+
+                 size_t count() const { return _count; }
+
+                 var assoc(var const & k, var const & v) const {
+                   var r;
+                   bool added = with(k, v, r);
+                   return obj<sorted_map>(r, _count + (added ? 1 : 0), cmp);
+                 }
+
+                 var dissoc(var const & k) const {
+                   var r;
+                   if (!without(k, r))
+                     return var((object*)this);
+                   return obj<sorted_map>(r, _count - 1, cmp);
+                 }
+
+                 // Adds every entry, a later one wins over an earlier one
+                 // with an equal key. An empty map is built bottom up from
+                 // the sorted entries instead of one insert at a time.
+                 var assoc_all(::std::vector<var> const & ks, ::std::vector<var> const & vs) const {
+                   if (_count != 0 || ks.size() < 2){
+                     var m((object*)this);
+                     for(size_t i = 0; i < ks.size(); i++)
+                       m = m.cast<sorted_map>()->assoc(ks[i], vs[i]);
+                     return m;
+                   }
+
+                   ::std::vector<size_t> order(ks.size());
+                   for(size_t i = 0; i < order.size(); i++)
+                     order[i] = i;
+                   sorted_order const & c = cmp;
+                   ::std::stable_sort(order.begin(), order.end(), [&ks, &c](size_t a, size_t b){
+                       return c(ks[a], ks[b]) < 0;
+                     });
+
+                   ::std::vector<var> keys;
+                   ::std::vector<var> vals;
+                   keys.reserve(ks.size());
+                   vals.reserve(ks.size());
+                   for(size_t i : order){
+                     if (!keys.empty() && cmp(keys.back(), ks[i]) == 0){
+                       vals.back() = vs[i];
+                       continue;
+                     }
+                     keys.push_back(ks[i]);
+                     vals.push_back(vs[i]);
+                   }
+                   size_t n = keys.size();
+                   return obj<sorted_map>(sorted_tree::build(keys, vals), n, cmp);
+                 }
+
+                 bool contains(var const & k) const {
+                   size_t at;
+                   return (lookup(k, at) != nullptr);
+                 }
+
+                 var val_at(var const & args) const {
+                   size_t at;
+                   sorted_node const * n = lookup(runtime::first(args), at);
+                   if (n == nullptr)
+                     return runtime::first(runtime::rest(args));
+                   return n->vals[at];
+                 }
+
+                 var invoke(var const & args) const final {
+                   return val_at(args);
+                 }
+
+                 // (key value) of the greatest key not greater than k, nil
+                 // when there is none. ceiling is the least not less than k.
+                 var floor(var const & k) const {
+                   sorted_tree::cursor c;
+                   if (!floor_of(k, c))
+                     return nil();
+                   return runtime::list(c.key(), c.val());
+                 }
+
+                 var ceiling(var const & k) const {
+                   sorted_tree::cursor c;
+                   if (!ceiling_of(k, c))
+                     return nil();
+                   return runtime::list(c.key(), c.val());
+                 }
+
+                 var seq() const {
+                   return range(nil(), true, nil(), false, false, false, false);
+                 }
+
+                 // Entries from lo up to hi, nil bounds leave that end open.
+                 var subseq(var const & lo, bool lo_inclusive, var const & hi, bool hi_inclusive) const {
+                   return range(lo, lo_inclusive, hi, hi_inclusive, !lo.is_nil(), !hi.is_nil(), false);
+                 }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return assoc(runtime::first(x), runtime::first(runtime::rest(x)));
+                 }
+
+                 var first() const final {
+                   return runtime::first(seq());
+                 }
+
+                 var rest() const final {
+                   return runtime::rest(seq());
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   sorted_tree::cursor c;
+                   for(c.seek_first(root); c.valid; c.next())
+                     if (!rf.step(acc, runtime::list(c.key(), c.val())))
+                       return false;
+                   return true;
+                 }
+               };
+
+               class sorted_set final : public lambda_i, public seekable_i, public sorted_base {
+                 exact_hash_cache _hash;
+               public:
+
+                 size_t type() const final { return runtime::type::sorted_set; }
+
+                 bool equals(var const & o) const final {
+                   if (this == o.get())
+                     return true;
+                   if (!o.is_type(runtime::type::sorted_set))
+                     return false;
+                   sorted_set * other = o.cast<sorted_set>();
+                   if (_count != other->count())
+                     return false;
+                   if (_hash.differs(other->_hash))
+                     return false;
+                   sorted_tree::cursor c;
+                   for(c.seek_first(root); c.valid; c.next())
+                     if (!other->contains(c.key()))
+                       return false;
+                   return true;
+                 }
+
+                 // Order independent, sum of the mixed element hashes.
+                 size_t hash() const final {
+                   size_t h;
+                   if (_hash.get(h))
+                     return h;
+                   h = 0;
+                   bool exact = true;
+                   sorted_tree::cursor c;
+                   for(c.seek_first(root); c.valid; c.next()){
+                     h += runtime::hash_mix(runtime::hash(c.key()));
+                     exact = exact && runtime::hash_exact(c.key());
+                   }
+                   _hash.set(h, exact);
+                   return h;
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("#{");
+                   sorted_tree::cursor c;
+                   for(c.seek_first(root); c.valid; c.next()){
+                     c.key().stream_console();
+                     sorted_tree::cursor n = c;
+                     n.next();
+                     if (n.valid)
+                       runtime::print(" ");
+                   }
+                   runtime::print("}");
+                 }
+               #endif
+
+                 explicit sorted_set(var const & comparator = nil()) :
+                   sorted_base(nil(), 0, sorted_order(comparator)) { }
+
+                 sorted_set(var const & r, size_t n, sorted_order const & o) :
+                   sorted_base(r, n, o) { }
+
+                 bool counted(size_t & n) const final { n = count(); return true; }
+
+                 size_t count() const { return _count; }
+
+                 var conj(var const & x) const {
+                   var r;
+                   bool added = with(x, nil(), r);
+                   if (!added)
+                     return var((object*)this);
+                   return obj<sorted_set>(r, _count + 1, cmp);
+                 }
+
+                 var disj(var const & x) const {
+                   var r;
+                   if (!without(x, r))
+                     return var((object*)this);
+                   return obj<sorted_set>(r, _count - 1, cmp);
+                 }
+
+                 bool contains(var const & x) const {
+                   size_t at;
+                   return (lookup(x, at) != nullptr);
+                 }
+
+                 // The stored element when present, else nil.
+                 var invoke(var const & args) const final {
+                   size_t at;
+                   sorted_node const * n = lookup(runtime::first(args), at);
+                   return (n == nullptr) ? nil() : n->keys[at];
+                 }
+
+                 var floor(var const & x) const {
+                   sorted_tree::cursor c;
+                   return floor_of(x, c) ? c.key() : nil();
+                 }
+
+                 var ceiling(var const & x) const {
+                   sorted_tree::cursor c;
+                   return ceiling_of(x, c) ? c.key() : nil();
+                 }
+
+                 var seq() const {
+                   return range(nil(), true, nil(), false, false, false, true);
+                 }
+
+                 var subseq(var const & lo, bool lo_inclusive, var const & hi, bool hi_inclusive) const {
+                   return range(lo, lo_inclusive, hi, hi_inclusive, !lo.is_nil(), !hi.is_nil(), true);
+                 }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return conj(x);
+                 }
+
+                 var first() const final {
+                   return runtime::first(seq());
+                 }
+
+                 var rest() const final {
+                   return runtime::rest(seq());
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   sorted_tree::cursor c;
+                   for(c.seek_first(root); c.valid; c.next())
+                     if (!rf.step(acc, c.key()))
+                       return false;
+                   return true;
+                 }
+               };
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_HASH_SET
+               #define FERRET_OBJECT_HASH_SET
+                 namespace runtime {
+                   namespace type {
+                      const size_t hash_node = 3984;
+                      const size_t hash_set = 3985;
+                      const size_t hash_seq = 3986;}}
+
+               #if defined(FERRET_STD_LIB)
+               // Hash array mapped trie node. Inline key value pairs come
+               // first in bit order, then child nodes; datamap and nodemap
+               // tell which of the 32 hash fragments each slot is for. Past
+               // the last fragment, keys with the same hash share a
+               // collision node searched linearly. A node below the root
+               // always holds at least two entries.
+               class hash_node final : public object {
+               public:
+                 ::std::uint32_t datamap;
+                 ::std::uint32_t nodemap;
+                 size_t data;
+                 size_t size;
+                 bool collision;
+                 ::std::vector<var> slots;
+
+                 size_t type() const final { return runtime::type::hash_node; }
+
+                 bool equals(var const & o) const final {
+                   return (this == o.get());
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("hash_node<");
+                   runtime::print(size);
+                   runtime::print(">");
+                 }
+               #endif
+
+                 hash_node() : datamap(0), nodemap(0), data(0), size(0), collision(false) { }
+
+                 size_t nodes() const { return slots.size() - 2 * data; }
+
+                 var const & key(size_t i) const { return slots[2 * i]; }
+
+                 var const & val(size_t i) const { return slots[2 * i + 1]; }
+
+                 var const & child_var(size_t i) const { return slots[2 * data + i]; }
+
+                 hash_node * child(size_t i) const { return slots[2 * data + i].cast<hash_node>(); }
+               };
+
+               namespace hash_trie {
+                 const size_t bits = 5;
+                 const size_t mask = (1 << bits) - 1;
+                 const size_t max_shift = sizeof(size_t) * 8;
+                 const size_t max_depth = max_shift / bits + 2;
+
+                 inline ::std::uint32_t bit(size_t h, size_t shift){
+                   return (::std::uint32_t)1 << ((h >> shift) & mask);
+                 }
+
+                 inline size_t popcount(::std::uint32_t x){
+                 #if defined(__GNUC__)
+                   return (size_t)__builtin_popcount(x);
+                 #else
+                   x = x - ((x >> 1) & 0x55555555);
+                   x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+                   return (size_t)((((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+                 #endif
+                 }
+
+                 // Slot of b among the ones set in map.
+                 inline size_t index(::std::uint32_t map, ::std::uint32_t b){
+                   return popcount(map & (b - 1));
+                 }
+
+                 inline var empty(){
+                   return obj<hash_node>();
+                 }
+
+                 inline var clone(hash_node const * n){
+                   var c = obj<hash_node>();
+                   hash_node * m = c.cast<hash_node>();
+                   m->datamap = n->datamap;
+                   m->nodemap = n->nodemap;
+                   m->data = n->data;
+                   m->size = n->size;
+                   m->collision = n->collision;
+                   m->slots = n->slots;
+                   return c;
+                 }
+
+                 // Node holding n and its slot there, nullptr if absent.
+                 inline hash_node const * find(hash_node const * n, var const & k, size_t h,
+                                               size_t shift, size_t & at){
+                   for(;; shift += bits){
+                     if (n->collision){
+                       for(at = 0; at < n->data; at++)
+                         if (n->key(at) == k)
+                           return n;
+                       return nullptr;
+                     }
+                     ::std::uint32_t b = bit(h, shift);
+                     if (n->datamap & b){
+                       at = index(n->datamap, b);
+                       return (n->key(at) == k) ? n : nullptr;
+                     }
+                     if (!(n->nodemap & b))
+                       return nullptr;
+                     n = n->child(index(n->nodemap, b));
+                   }
+                 }
+
+                 // Keys are stored under their own hash. A number near the
+                 // edge of its hash cell may equal one stored under the
+                 // neighbouring cell, lookups that miss try there as well.
+                 inline hash_node const * lookup(hash_node const * n, var const & k, size_t & at){
+                   hash_node const * r = find(n, k, runtime::hash(k), 0, at);
+                   size_t near;
+                   if (r == nullptr && runtime::hash_near(k, near))
+                     r = find(n, k, near, 0, at);
+                   return r;
+                 }
+
+                 // Hash to assoc or dissoc k under, that of the equal key
+                 // when one is stored under the neighbouring cell.
+                 inline size_t locate(hash_node const * n, var const & k){
+                   size_t h = runtime::hash(k);
+                   size_t near, at;
+                   if (runtime::hash_near(k, near) && find(n, k, h, 0, at) == nullptr &&
+                       find(n, k, near, 0, at) != nullptr)
+                     return near;
+                   return h;
+                 }
+
+                 // Smallest subtree holding two entries that differ.
+                 inline var pair(var const & k1, var const & v1, size_t h1,
+                                 var const & k2, var const & v2, size_t h2, size_t shift){
+                   var p = obj<hash_node>();
+                   hash_node * n = p.cast<hash_node>();
+                   n->size = 2;
+                   if (shift >= max_shift){
+                     n->collision = true;
+                     n->data = 2;
+                     n->slots = { k1, v1, k2, v2 };
+                     return p;
+                   }
+                   ::std::uint32_t b1 = bit(h1, shift);
+                   ::std::uint32_t b2 = bit(h2, shift);
+                   if (b1 == b2){
+                     n->nodemap = b1;
+                     n->slots = { pair(k1, v1, h1, k2, v2, h2, shift + bits) };
+                     return p;
+                   }
+                   n->datamap = b1 | b2;
+                   n->data = 2;
+                   if (b1 < b2)
+                     n->slots = { k1, v1, k2, v2 };
+                   else
+                     n->slots = { k2, v2, k1, v1 };
+                   return p;
+                 }
+
+                 // When replace is false an existing entry is kept as is.
+                 inline var assoc(hash_node const * n, var const & k, var const & v, size_t h,
+                                  size_t shift, bool replace, bool & added){
+                   if (n->collision){
+                     size_t at;
+                     var c = clone(n);
+                     hash_node * m = c.cast<hash_node>();
+                     added = (find(n, k, h, shift, at) == nullptr);
+                     if (!added){
+                       if (replace)
+                         m->slots[2 * at + 1] = v;
+                       return c;
+                     }
+                     m->slots.insert(m->slots.begin() + 2 * m->data, { k, v });
+                     m->data++;
+                     m->size++;
+                     return c;
+                   }
+
+                   ::std::uint32_t b = bit(h, shift);
+                   var c = clone(n);
+                   hash_node * m = c.cast<hash_node>();
+
+                   if (n->datamap & b){
+                     size_t at = index(n->datamap, b);
+                     added = !(n->key(at) == k);
+                     if (!added){
+                       if (replace)
+                         m->slots[2 * at + 1] = v;
+                       return c;
+                     }
+                     var sub = pair(n->key(at), n->val(at), runtime::hash(n->key(at)),
+                                    k, v, h, shift + bits);
+                     size_t child_at = index(n->nodemap, b);
+                     m->slots.erase(m->slots.begin() + 2 * at, m->slots.begin() + 2 * at + 2);
+                     m->data--;
+                     m->slots.insert(m->slots.begin() + 2 * m->data + child_at, sub);
+                     m->datamap ^= b;
+                     m->nodemap |= b;
+                     m->size++;
+                     return c;
+                   }
+
+                   if (n->nodemap & b){
+                     size_t at = index(n->nodemap, b);
+                     var sub = assoc(n->child(at), k, v, h, shift + bits, replace, added);
+                     m->slots[2 * m->data + at] = sub;
+                     m->size += added ? 1 : 0;
+                     return c;
+                   }
+
+                   size_t at = index(n->datamap, b);
+                   m->slots.insert(m->slots.begin() + 2 * at, { k, v });
+                   m->datamap |= b;
+                   m->data++;
+                   m->size++;
+                   added = true;
+                   return c;
+                 }
+
+                 // Same as assoc replacing values, but nodes only the caller
+                 // refers to are changed in place instead of copied. The
+                 // nodes a transient copied once are its own after that.
+                 inline void insert(var & node, var const & k, var const & v, size_t h,
+                                    size_t shift, bool & added){
+                   if (!node.is_unique()){
+                     node = assoc(node.cast<hash_node>(), k, v, h, shift, true, added);
+                     return;
+                   }
+
+                   hash_node * m = node.cast<hash_node>();
+                   if (m->collision){
+                     size_t at;
+                     added = (find(m, k, h, shift, at) == nullptr);
+                     if (!added){
+                       m->slots[2 * at + 1] = v;
+                       return;
+                     }
+                     m->slots.insert(m->slots.begin() + 2 * m->data, { k, v });
+                     m->data++;
+                     m->size++;
+                     return;
+                   }
+
+                   ::std::uint32_t b = bit(h, shift);
+                   if (m->datamap & b){
+                     size_t at = index(m->datamap, b);
+                     added = !(m->key(at) == k);
+                     if (!added){
+                       m->slots[2 * at + 1] = v;
+                       return;
+                     }
+                     var sub = pair(m->key(at), m->val(at), runtime::hash(m->key(at)),
+                                    k, v, h, shift + bits);
+                     size_t child_at = index(m->nodemap, b);
+                     m->slots.erase(m->slots.begin() + 2 * at, m->slots.begin() + 2 * at + 2);
+                     m->data--;
+                     m->slots.insert(m->slots.begin() + 2 * m->data + child_at, sub);
+                     m->datamap ^= b;
+                     m->nodemap |= b;
+                     m->size++;
+                     return;
+                   }
+
+                   if (m->nodemap & b){
+                     size_t at = index(m->nodemap, b);
+                     insert(m->slots[2 * m->data + at], k, v, h, shift + bits, added);
+                     m->size += added ? 1 : 0;
+                     return;
+                   }
+
+                   size_t at = index(m->datamap, b);
+                   m->slots.insert(m->slots.begin() + 2 * at, { k, v });
+                   m->datamap |= b;
+                   m->data++;
+                   m->size++;
+                   added = true;
+                 }
+
+                 // nil when k is not there.
+                 inline var dissoc(hash_node const * n, var const & k, size_t h, size_t shift){
+                   size_t at;
+                   if (n->collision){
+                     if (find(n, k, h, shift, at) == nullptr)
+                       return nil();
+                     var c = clone(n);
+                     hash_node * m = c.cast<hash_node>();
+                     m->slots.erase(m->slots.begin() + 2 * at, m->slots.begin() + 2 * at + 2);
+                     m->data--;
+                     m->size--;
+                     return c;
+                   }
+
+                   ::std::uint32_t b = bit(h, shift);
+                   if (n->datamap & b){
+                     at = index(n->datamap, b);
+                     if (!(n->key(at) == k))
+                       return nil();
+                     var c = clone(n);
+                     hash_node * m = c.cast<hash_node>();
+                     m->slots.erase(m->slots.begin() + 2 * at, m->slots.begin() + 2 * at + 2);
+                     m->datamap ^= b;
+                     m->data--;
+                     m->size--;
+                     return c;
+                   }
+
+                   if (!(n->nodemap & b))
+                     return nil();
+
+                   at = index(n->nodemap, b);
+                   var sub = dissoc(n->child(at), k, h, shift + bits);
+                   if (sub.is_nil())
+                     return nil();
+
+                   var c = clone(n);
+                   hash_node * m = c.cast<hash_node>();
+                   hash_node const * s = sub.cast<hash_node>();
+                   m->size--;
+                   if (s->size != 1){
+                     m->slots[2 * m->data + at] = sub;
+                     return c;
+                   }
+                   // Last entry below moves up into this node.
+                   size_t data_at = index(n->datamap, b);
+                   m->slots.erase(m->slots.begin() + 2 * m->data + at);
+                   m->slots.insert(m->slots.begin() + 2 * data_at, { s->key(0), s->val(0) });
+                   m->nodemap ^= b;
+                   m->datamap |= b;
+                   m->data++;
+                   return c;
+                 }
+
+                 // Collects a node in bit order, pulling single entry
+                 // children up and dropping empty ones.
+                 class builder{
+                   ::std::vector<var> data;
+                   ::std::vector<var> nodes;
+                   ::std::uint32_t datamap;
+                   ::std::uint32_t nodemap;
+                   size_t size;
+                 public:
+                   builder() : datamap(0), nodemap(0), size(0) { }
+
+                   void entry(::std::uint32_t b, var const & k, var const & v){
+                     datamap |= b;
+                     data.push_back(k);
+                     data.push_back(v);
+                     size++;
+                   }
+
+                   void node(::std::uint32_t b, var const & n){
+                     hash_node const * c = n.cast<hash_node>();
+                     if (c->size == 0)
+                       return;
+                     if (c->size == 1){
+                       entry(b, c->key(0), c->val(0));
+                       return;
+                     }
+                     nodemap |= b;
+                     nodes.push_back(n);
+                     size += c->size;
+                   }
+
+                   var done(){
+                     var r = obj<hash_node>();
+                     hash_node * n = r.cast<hash_node>();
+                     n->datamap = datamap;
+                     n->nodemap = nodemap;
+                     n->data = data.size() / 2;
+                     n->size = size;
+                     n->slots.swap(data);
+                     n->slots.insert(n->slots.end(), nodes.begin(), nodes.end());
+                     return r;
+                   }
+                 };
+
+                 // Collision nodes are small, they are merged entry by entry.
+                 inline var collision_filter(hash_node const * a, hash_node const * b, size_t shift, bool keep_common){
+                   var r = obj<hash_node>();
+                   hash_node * n = r.cast<hash_node>();
+                   n->collision = true;
+                   for(size_t i = 0; i < a->data; i++){
+                     size_t at;
+                     bool common = (find(b, a->key(i), 0, shift, at) != nullptr);
+                     if (common == keep_common){
+                       n->slots.push_back(a->key(i));
+                       n->slots.push_back(a->val(i));
+                       n->data++;
+                     }
+                   }
+                   n->size = n->data;
+                   return r;
+                 }
+
+                 // Entries of both, values from b where keys meet.
+                 inline var unite(var const & x, var const & y, size_t shift){
+                   if (x.get() == y.get())
+                     return x;
+                   hash_node const * a = x.cast<hash_node>();
+                   hash_node const * b = y.cast<hash_node>();
+
+                   if (a->collision){
+                     var r = x;
+                     bool added;
+                     for(size_t i = 0; i < b->data; i++)
+                       r = assoc(r.cast<hash_node>(), b->key(i), b->val(i), 0, shift, true, added);
+                     return r;
+                   }
+
+                   builder out;
+                   for(size_t f = 0; f <= mask; f++){
+                     ::std::uint32_t bt = (::std::uint32_t)1 << f;
+                     bool ad = a->datamap & bt, an = a->nodemap & bt;
+                     bool bd = b->datamap & bt, bn = b->nodemap & bt;
+                     size_t ai = index(ad ? a->datamap : a->nodemap, bt);
+                     size_t bi = index(bd ? b->datamap : b->nodemap, bt);
+                     bool added;
+
+                     if (!ad && !an){
+                       if (bd)
+                         out.entry(bt, b->key(bi), b->val(bi));
+                       else if (bn)
+                         out.node(bt, b->child_var(bi));
+                     }else if (!bd && !bn){
+                       if (ad)
+                         out.entry(bt, a->key(ai), a->val(ai));
+                       else
+                         out.node(bt, a->child_var(ai));
+                     }else if (ad && bd){
+                       var const & ka = a->key(ai);
+                       var const & kb = b->key(bi);
+                       if (ka == kb)
+                         out.entry(bt, kb, b->val(bi));
+                       else
+                         out.node(bt, pair(ka, a->val(ai), runtime::hash(ka),
+                                           kb, b->val(bi), runtime::hash(kb), shift + bits));
+                     }else if (ad){
+                       var const & ka = a->key(ai);
+                       out.node(bt, assoc(b->child(bi), ka, a->val(ai), runtime::hash(ka),
+                                          shift + bits, false, added));
+                     }else if (bd){
+                       var const & kb = b->key(bi);
+                       out.node(bt, assoc(a->child(ai), kb, b->val(bi), runtime::hash(kb),
+                                          shift + bits, true, added));
+                     }else{
+                       out.node(bt, unite(a->child_var(ai), b->child_var(bi), shift + bits));
+                     }
+                   }
+                   return out.done();
+                 }
+
+                 // Entries of a whose keys are in b.
+                 inline var intersect(var const & x, var const & y, size_t shift){
+                   if (x.get() == y.get())
+                     return x;
+                   hash_node const * a = x.cast<hash_node>();
+                   hash_node const * b = y.cast<hash_node>();
+
+                   if (a->collision)
+                     return collision_filter(a, b, shift, true);
+
+                   builder out;
+                   ::std::uint32_t common = (a->datamap | a->nodemap) & (b->datamap | b->nodemap);
+                   for(size_t f = 0; f <= mask; f++){
+                     ::std::uint32_t bt = (::std::uint32_t)1 << f;
+                     if (!(common & bt))
+                       continue;
+                     bool ad = a->datamap & bt;
+                     bool bd = b->datamap & bt;
+                     size_t ai = index(ad ? a->datamap : a->nodemap, bt);
+                     size_t bi = index(bd ? b->datamap : b->nodemap, bt);
+                     size_t at;
+
+                     if (ad && bd){
+                       if (a->key(ai) == b->key(bi))
+                         out.entry(bt, a->key(ai), a->val(ai));
+                     }else if (ad){
+                       var const & ka = a->key(ai);
+                       if (find(b->child(bi), ka, runtime::hash(ka), shift + bits, at) != nullptr)
+                         out.entry(bt, ka, a->val(ai));
+                     }else if (bd){
+                       var const & kb = b->key(bi);
+                       hash_node const * n = find(a->child(ai), kb, runtime::hash(kb), shift + bits, at);
+                       if (n != nullptr)
+                         out.entry(bt, n->key(at), n->val(at));
+                     }else{
+                       out.node(bt, intersect(a->child_var(ai), b->child_var(bi), shift + bits));
+                     }
+                   }
+                   return out.done();
+                 }
+
+                 // Entries of a whose keys are not in b.
+                 inline var difference(var const & x, var const & y, size_t shift){
+                   if (x.get() == y.get())
+                     return empty();
+                   hash_node const * a = x.cast<hash_node>();
+                   hash_node const * b = y.cast<hash_node>();
+
+                   if (a->collision)
+                     return collision_filter(a, b, shift, false);
+
+                   builder out;
+                   for(size_t f = 0; f <= mask; f++){
+                     ::std::uint32_t bt = (::std::uint32_t)1 << f;
+                     bool ad = a->datamap & bt, an = a->nodemap & bt;
+                     bool bd = b->datamap & bt, bn = b->nodemap & bt;
+                     if (!ad && !an)
+                       continue;
+                     size_t ai = index(ad ? a->datamap : a->nodemap, bt);
+                     size_t bi = index(bd ? b->datamap : b->nodemap, bt);
+                     size_t at;
+
+                     if (!bd && !bn){
+                       if (ad)
+                         out.entry(bt, a->key(ai), a->val(ai));
+                       else
+                         out.node(bt, a->child_var(ai));
+                     }else if (ad && bd){
+                       if (!(a->key(ai) == b->key(bi)))
+                         out.entry(bt, a->key(ai), a->val(ai));
+                     }else if (ad){
+                       var const & ka = a->key(ai);
+                       if (find(b->child(bi), ka, runtime::hash(ka), shift + bits, at) == nullptr)
+                         out.entry(bt, ka, a->val(ai));
+                     }else if (bd){
+                       var const & kb = b->key(bi);
+                       var sub = dissoc(a->child(ai), kb, runtime::hash(kb), shift + bits);
+                       out.node(bt, sub.is_nil() ? a->child_var(ai) : sub);
+                     }else{
+                       out.node(bt, difference(a->child_var(ai), b->child_var(bi), shift + bits));
+                     }
+                   }
+                   return out.done();
+                 }
+
+                 // Position in the trie, kept as the path from the root.
+                 struct cursor{
+                   hash_node const * path[max_depth];
+                   size_t index[max_depth];
+                   size_t depth;
+                   bool valid;
+
+                   cursor() : depth(0), valid(false) { }
+
+                   var const & key() const { return path[depth - 1]->key(index[depth - 1]); }
+                   var const & val() const { return path[depth - 1]->val(index[depth - 1]); }
+
+                   void settle(){
+                     for(;;){
+                       hash_node const * n = path[depth - 1];
+                       size_t i = index[depth - 1];
+                       if (i < n->data){
+                         valid = true;
+                         return;
+                       }
+                       if (i < n->data + n->nodes()){
+                         path[depth] = n->child(i - n->data);
+                         index[depth++] = 0;
+                         continue;
+                       }
+                       if (depth == 1){
+                         valid = false;
+                         return;
+                       }
+                       depth--;
+                       index[depth - 1]++;
+                     }
+                   }
+
+                   void seek_first(var const & root){
+                     path[0] = root.cast<hash_node>();
+                     index[0] = 0;
+                     depth = 1;
+                     settle();
+                   }
+
+                   void next(){
+                     index[depth - 1]++;
+                     settle();
+                   }
+                 };
+               }
+
+               // Walk over a hash set or map in trie order.
+               class hash_seq final : public object, public seekable_i {
+                 var root;
+                 hash_trie::cursor at;
+                 bool set;
+
+                 var entry(hash_trie::cursor const & c) const {
+                   if (set)
+                     return c.key();
+                   return runtime::list(c.key(), c.val());
+                 }
+
+               public:
+
+                 size_t type() const final { return runtime::type::hash_seq; }
+
+                 bool equals(var const & o) const final {
+                   var other = o;
+                   for(hash_trie::cursor c = at; c.valid; c.next()){
+                     if (entry(c) != runtime::first(other))
+                       return false;
+                     other = runtime::rest(other);
+                   }
+                   return (other.is_nil() || other.is_type(runtime::type::empty_sequence));
+                 }
+
+                 size_t hash() const final { return runtime::hash_ordered(var((object*)this)); }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("(");
+                   for(hash_trie::cursor c = at; c.valid; c.next()){
+                     if (c.path[c.depth - 1] != at.path[at.depth - 1] ||
+                         c.index[c.depth - 1] != at.index[at.depth - 1])
+                       runtime::print(" ");
+                     entry(c).stream_console();
+                   }
+                   runtime::print(")");
+                 }
+               #endif
+
+                 hash_seq(var const & r, hash_trie::cursor const & c, bool s) :
+                   root(r), at(c), set(s) { }
+
+                 // nil when the trie is empty.
+                 static var from(var const & root, bool set){
+                   hash_trie::cursor c;
+                   c.seek_first(root);
+                   if (!c.valid)
+                     return nil();
+                   return obj<hash_seq>(root, c, set);
+                 }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return runtime::make_cell(x, var(this));
+                 }
+
+                 var first() const final {
+                   return entry(at);
+                 }
+
+                 var rest() const final {
+                   hash_trie::cursor c = at;
+                   c.next();
+                   if (!c.valid)
+                     return nil();
+                   return obj<hash_seq>(root, c, set);
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   for(hash_trie::cursor c = at; c.valid; c.next())
+                     if (!rf.step(acc, entry(c)))
+                       return false;
+                   return true;
+                 }
+               };
+
+               class hash_set final : public lambda_i, public seekable_i {
+                 var root;
+                 exact_hash_cache _hash;
+
+                 hash_node const * node() const { return root.cast<hash_node>(); }
+
+                 // Sets built from anything else go through conj.
+                 static var set_of(var const & coll){
+                   if (!coll.is_nil() && coll.is_type(runtime::type::hash_set))
+                     return coll;
+                   return from(coll);
+                 }
+
+                 // True when no element sits near the edge of its hash
+                 // cell, equal elements of two such sets are then at the
+                 // same place in both tries.
+                 bool exact() const {
+                   hash();
+                   return _hash.is_exact();
+                 }
+
+                 // Set algebra for sets holding numbers an equal one may
+                 // be stored under another hash, one element at a time.
+                 var select(hash_set const * other, bool keep_common) const {
+                   var r = obj<hash_set>();
+                   hash_trie::cursor c;
+                   for(c.seek_first(root); c.valid; c.next())
+                     if (other->contains(c.key()) == keep_common)
+                       r = r.cast<hash_set>()->conj(c.key());
+                   return r;
+                 }
+
+               public:
+
+                 size_t type() const final { return runtime::type::hash_set; }
+
+                 bool equals(var const & o) const final {
+                   if (this == o.get())
+                     return true;
+                   if (!o.is_type(runtime::type::hash_set))
+                     return false;
+                   hash_set * other = o.cast<hash_set>();
+                   if (count() != other->count())
+                     return false;
+                   if (_hash.differs(other->_hash))
+                     return false;
+                   hash_trie::cursor c;
+                   for(c.seek_first(root); c.valid; c.next())
+                     if (!other->contains(c.key()))
+                       return false;
+                   return true;
+                 }
+
+                 // Same as sorted_set, the sum of the mixed element hashes.
+                 size_t hash() const final {
+                   size_t h;
+                   if (_hash.get(h))
+                     return h;
+                   h = 0;
+                   bool exact = true;
+                   hash_trie::cursor c;
+                   for(c.seek_first(root); c.valid; c.next()){
+                     h += runtime::hash_mix(runtime::hash(c.key()));
+                     exact = exact && runtime::hash_exact(c.key());
+                   }
+                   _hash.set(h, exact);
+                   return h;
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("#{");
+                   hash_trie::cursor c;
+                   for(c.seek_first(root); c.valid; c.next()){
+                     c.key().stream_console();
+                     hash_trie::cursor n = c;
+                     n.next();
+                     if (n.valid)
+                       runtime::print(" ");
+                   }
+                   runtime::print("}");
+                 }
+               #endif
+
+                 hash_set() : root(hash_trie::empty()) { }
+
+                 explicit hash_set(var const & r) : root(r) { }
+
+                 static var from(var const & coll){
+                   var s = obj<hash_set>();
+                   for(auto const& x : runtime::range(coll))
+                     s = s.cast<hash_set>()->conj(x);
+                   return s;
+                 }
+
+                 bool counted(size_t & n) const final { n = count(); return true; }
+
+                 size_t count() const { return node()->size; }
+
+                 var conj(var const & x) const {
+                   bool added;
+                   var r = hash_trie::assoc(node(), x, nil(), hash_trie::locate(node(), x), 0, false, added);
+                   if (!added)
+                     return var((object*)this);
+                   return obj<hash_set>(r);
+                 }
+
+                 var disj(var const & x) const {
+                   var r = hash_trie::dissoc(node(), x, hash_trie::locate(node(), x), 0);
+                   if (r.is_nil())
+                     return var((object*)this);
+                   return obj<hash_set>(r);
+                 }
+
+                 bool contains(var const & x) const {
+                   size_t at;
+                   return (hash_trie::lookup(node(), x, at) != nullptr);
+                 }
+
+                 // The stored element when present, else nil.
+                 var invoke(var const & args) const final {
+                   var x = runtime::first(args);
+                   size_t at;
+                   hash_node const * n = hash_trie::lookup(node(), x, at);
+                   return (n == nullptr) ? nil() : n->key(at);
+                 }
+
+                 // Set algebra walks both tries together, subtrees only one
+                 // side has, or both share, are reused without a look inside.
+                 var unite(var const & o) const {
+                   var s = set_of(o);
+                   hash_set const * other = s.cast<hash_set>();
+                   if (exact() && other->exact())
+                     return obj<hash_set>(hash_trie::unite(root, other->root, 0));
+                   var r = var((object*)this);
+                   hash_trie::cursor c;
+                   for(c.seek_first(other->root); c.valid; c.next())
+                     r = r.cast<hash_set>()->conj(c.key());
+                   return r;
+                 }
+
+                 var intersect(var const & o) const {
+                   var s = set_of(o);
+                   hash_set const * other = s.cast<hash_set>();
+                   if (exact() && other->exact())
+                     return obj<hash_set>(hash_trie::intersect(root, other->root, 0));
+                   return select(other, true);
+                 }
+
+                 var difference(var const & o) const {
+                   var s = set_of(o);
+                   hash_set const * other = s.cast<hash_set>();
+                   if (exact() && other->exact())
+                     return obj<hash_set>(hash_trie::difference(root, other->root, 0));
+                   return select(other, false);
+                 }
+
+                 var seq() const {
+                   return hash_seq::from(root, true);
+                 }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return conj(x);
+                 }
+
+                 var first() const final {
+                   return runtime::first(seq());
+                 }
+
+                 var rest() const final {
+                   return runtime::rest(seq());
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   hash_trie::cursor c;
+                   for(c.seek_first(root); c.valid; c.next())
+                     if (!rf.step(acc, c.key()))
+                       return false;
+                   return true;
+                 }
+               };
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_HASH_MAP
+               #define FERRET_OBJECT_HASH_MAP
+                 namespace runtime {
+                   namespace type {
+                      const size_t hash_map = 3987;
+                      const size_t array_map = 3988;}}
+
+               #if defined(FERRET_STD_LIB)
+               #if !defined(FERRET_ARRAY_MAP_SIZE)
+                 # define FERRET_ARRAY_MAP_SIZE 8
+               #endif
+
+               namespace runtime {
+                 // Shared by hash_map and array_map, so either can be
+                 // compared against the other.
+                 inline bool is_hashed_map(var const & m);
+                 inline size_t map_count(var const & m);
+                 inline bool map_find(var const & m, var const & k, var & v);
+                 inline exact_hash_cache const & map_hash(var const & m);
+               }
+
+               class hash_map final : public lambda_i, public seekable_i {
+                 var root;
+                 exact_hash_cache _hash;
+
+                 hash_node const * node() const { return root.cast<hash_node>(); }
+
+               public:
+
+                 size_t type() const final { return runtime::type::hash_map; }
+
+                 bool equals(var const & o) const final;
+
+                 // Same as the hash of a d_list with these entries.
+                 size_t hash() const final {
+                   size_t h;
+                   if (_hash.get(h))
+                     return h;
+                   h = 0;
+                   bool exact = true;
+                   hash_trie::cursor c;
+                   for(c.seek_first(root); c.valid; c.next()){
+                     h += runtime::hash_mix(runtime::hash(c.key()) * 31 + runtime::hash(c.val()));
+                     exact = exact && runtime::hash_exact(c.key()) && runtime::hash_exact(c.val());
+                   }
+                   _hash.set(h, exact);
+                   return h;
+                 }
+
+                 // Cache filled in, for map_equals.
+                 exact_hash_cache const & hashed() const {
+                   hash();
+                   return _hash;
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("{");
+                   hash_trie::cursor c;
+                   for(c.seek_first(root); c.valid; c.next()){
+                     c.key().stream_console();
+                     runtime::print(" ");
+                     c.val().stream_console();
+                     hash_trie::cursor n = c;
+                     n.next();
+                     if (n.valid)
+                       runtime::print(", ");
+                   }
+                   runtime::print("}");
+                 }
+               #endif
+
+                 hash_map() : root(hash_trie::empty()) { }
+
+                 explicit hash_map(var const & r) : root(r) { }
+
+                 var const & trie() const { return root; }
+
+                 bool counted(size_t & n) const final { n = count(); return true; }
+
+                 size_t count() const { return node()->size; }
+
+                 var assoc(var const & k, var const & v) const {
+                   bool added;
+                   return obj<hash_map>(hash_trie::assoc(node(), k, v, hash_trie::locate(node(), k), 0, true, added));
+                 }
+
+                 var dissoc(var const & k) const {
+                   var r = hash_trie::dissoc(node(), k, hash_trie::locate(node(), k), 0);
+                   if (r.is_nil())
+                     return var((object*)this);
+                   return obj<hash_map>(r);
+                 }
+
+                 bool find(var const & k, var & v) const {
+                   size_t at;
+                   hash_node const * n = hash_trie::lookup(node(), k, at);
+                   if (n == nullptr)
+                     return false;
+                   v = n->val(at);
+                   return true;
+                 }
+
+                 bool contains(var const & k) const {
+                   var v;
+                   return find(k, v);
+                 }
+
+                 var val_at(var const & args) const {
+                   var v;
+                   if (find(runtime::first(args), v))
+                     return v;
+                   return runtime::first(runtime::rest(args));
+                 }
+
+                 var invoke(var const & args) const final {
+                   return val_at(args);
+                 }
+
+                 var seq() const {
+                   return hash_seq::from(root, false);
+                 }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return assoc(runtime::first(x), runtime::first(runtime::rest(x)));
+                 }
+
+                 var first() const final {
+                   return runtime::first(seq());
+                 }
+
+                 var rest() const final {
+                   return runtime::rest(seq());
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   hash_trie::cursor c;
+                   for(c.seek_first(root); c.valid; c.next())
+                     if (!rf.step(acc, runtime::list(c.key(), c.val())))
+                       return false;
+                   return true;
+                 }
+               };
+
+               // Map of up to FERRET_ARRAY_MAP_SIZE entries in a single
+               // object, it turns into a hash_map when it grows past that.
+               // Keyword keys also keep their word in words, a keyword
+               // lookup compares all of them in one fixed length loop and
+               // masks out the slots that are not keywords.
+               class array_map final : public lambda_i, public seekable_i {
+                 static const size_t capacity = FERRET_ARRAY_MAP_SIZE;
+
+                 size_t size;
+                 unsigned int keywords;
+                 number_t words[capacity];
+                 var keys[capacity];
+                 var vals[capacity];
+                 exact_hash_cache _hash;
+
+                 static int lowest(unsigned int bits){
+                 #if defined(__GNUC__)
+                   return __builtin_ctz(bits);
+                 #else
+                   int i = 0;
+                   while (!(bits & 1)){
+                     bits >>= 1;
+                     i++;
+                   }
+                   return i;
+                 #endif
+                 }
+
+                 void put(size_t i, var const & k, var const & v){
+                   keys[i] = k;
+                   vals[i] = v;
+                   if (!k.is_nil() && k.is_type(runtime::type::keyword)){
+                     words[i] = k.cast<keyword>()->word();
+                     keywords |= 1u << i;
+                   }else{
+                     words[i] = 0;
+                     keywords &= ~(1u << i);
+                   }
+                 }
+
+                 var copy() const {
+                   var c = obj<array_map>();
+                   array_map * m = c.cast<array_map>();
+                   m->size = size;
+                   m->keywords = keywords;
+                   for(size_t i = 0; i < size; i++){
+                     m->words[i] = words[i];
+                     m->keys[i] = keys[i];
+                     m->vals[i] = vals[i];
+                   }
+                   return c;
+                 }
+
+               public:
+
+                 size_t type() const final { return runtime::type::array_map; }
+
+                 bool equals(var const & o) const final;
+
+                 size_t hash() const final {
+                   size_t h;
+                   if (_hash.get(h))
+                     return h;
+                   h = 0;
+                   bool exact = true;
+                   for(size_t i = 0; i < size; i++){
+                     h += runtime::hash_mix(runtime::hash(keys[i]) * 31 + runtime::hash(vals[i]));
+                     exact = exact && runtime::hash_exact(keys[i]) && runtime::hash_exact(vals[i]);
+                   }
+                   _hash.set(h, exact);
+                   return h;
+                 }
+
+                 // Cache filled in, for map_equals.
+                 exact_hash_cache const & hashed() const {
+                   hash();
+                   return _hash;
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("{");
+                   for(size_t i = 0; i < size; i++){
+                     if (i != 0)
+                       runtime::print(", ");
+                     keys[i].stream_console();
+                     runtime::print(" ");
+                     vals[i].stream_console();
+                   }
+                   runtime::print("}");
+                 }
+               #endif
+
+                 array_map() : size(0), keywords(0) {
+                   for(size_t i = 0; i < capacity; i++)
+                     words[i] = 0;
+                 }
+
+                 bool counted(size_t & n) const final { n = count(); return true; }
+
+                 size_t count() const { return size; }
+
+                 int index_of(var const & k) const {
+                   if (!k.is_nil() && k.is_type(runtime::type::keyword)){
+                     number_t w = k.cast<keyword>()->word();
+                     unsigned int hits = 0;
+                     for(size_t i = 0; i < capacity; i++)
+                       hits |= (unsigned int)(words[i] == w) << i;
+                     hits &= keywords;
+                     return hits ? lowest(hits) : -1;
+                   }
+                   for(size_t i = 0; i < size; i++)
+                     if (keys[i] == k)
+                       return (int)i;
+                   return -1;
+                 }
+
+                 var assoc(var const & k, var const & v) const {
+                   int i = index_of(k);
+                   if (i != -1){
+                     var c = copy();
+                     c.cast<array_map>()->vals[i] = v;
+                     return c;
+                   }
+                   if (size < capacity){
+                     var c = copy();
+                     array_map * m = c.cast<array_map>();
+                     m->put(m->size++, k, v);
+                     return c;
+                   }
+                   var m = obj<hash_map>();
+                   for(size_t j = 0; j < size; j++)
+                     m = m.cast<hash_map>()->assoc(keys[j], vals[j]);
+                   return m.cast<hash_map>()->assoc(k, v);
+                 }
+
+                 // Map of distinct keys, at most FERRET_ARRAY_MAP_SIZE.
+                 static var from(::std::vector<var> const & ks, ::std::vector<var> const & vs){
+                   var c = obj<array_map>();
+                   array_map * m = c.cast<array_map>();
+                   for(size_t i = 0; i < ks.size(); i++)
+                     m->put(m->size++, ks[i], vs[i]);
+                   return c;
+                 }
+
+                 var dissoc(var const & k) const {
+                   int i = index_of(k);
+                   if (i == -1)
+                     return var((object*)this);
+                   var c = obj<array_map>();
+                   array_map * m = c.cast<array_map>();
+                   for(size_t j = 0; j < size; j++)
+                     if (j != (size_t)i)
+                       m->put(m->size++, keys[j], vals[j]);
+                   return c;
+                 }
+
+                 bool find(var const & k, var & v) const {
+                   int i = index_of(k);
+                   if (i == -1)
+                     return false;
+                   v = vals[i];
+                   return true;
+                 }
+
+                 bool contains(var const & k) const {
+                   return (index_of(k) != -1);
+                 }
+
+                 var val_at(var const & args) const {
+                   int i = index_of(runtime::first(args));
+                   if (i == -1)
+                     return runtime::first(runtime::rest(args));
+                   return vals[i];
+                 }
+
+                 var invoke(var const & args) const final {
+                   return val_at(args);
+                 }
+
+                 var seq() const {
+                   var s;
+                   for(size_t i = size; i > 0; i--)
+                     s = runtime::cons(runtime::list(keys[i - 1], vals[i - 1]), s);
+                   return s;
+                 }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return assoc(runtime::first(x), runtime::first(runtime::rest(x)));
+                 }
+
+                 var first() const final {
+                   if (size == 0)
+                     return nil();
+                   return runtime::list(keys[0], vals[0]);
+                 }
+
+                 var rest() const final {
+                   return runtime::rest(seq());
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   for(size_t i = 0; i < size; i++)
+                     if (!rf.step(acc, runtime::list(keys[i], vals[i])))
+                       return false;
+                   return true;
+                 }
+               };
+
+               namespace runtime {
+                 inline bool is_hashed_map(var const & m){
+                   return (!m.is_nil() &&
+                           (m.is_type(type::hash_map) || m.is_type(type::array_map)));
+                 }
+
+                 inline size_t map_count(var const & m){
+                   if (m.is_type(type::array_map))
+                     return m.cast<array_map>()->count();
+                   return m.cast<hash_map>()->count();
+                 }
+
+                 inline bool map_find(var const & m, var const & k, var & v){
+                   if (m.is_type(type::array_map))
+                     return m.cast<array_map>()->find(k, v);
+                   return m.cast<hash_map>()->find(k, v);
+                 }
+
+                 inline exact_hash_cache const & map_hash(var const & m){
+                   if (m.is_type(type::array_map))
+                     return m.cast<array_map>()->hashed();
+                   return m.cast<hash_map>()->hashed();
+                 }
+
+                 // Same keys mapped to equal values, whatever the layout.
+                 inline bool map_equals(var const & m, var const & o){
+                   if (m.get() == o.get())
+                     return true;
+                   if (!is_hashed_map(o) || map_count(m) != map_count(o))
+                     return false;
+                   if (map_hash(m).differs(map_hash(o)))
+                     return false;
+                   for(auto const& e : range(m)){
+                     var v;
+                     if (!map_find(o, first(e), v) || v != first(rest(e)))
+                       return false;
+                   }
+                   return true;
+                 }
+               }
+
+               inline bool hash_map::equals(var const & o) const {
+                 return runtime::map_equals(var((object*)this), o);
+               }
+
+               inline bool array_map::equals(var const & o) const {
+                 return runtime::map_equals(var((object*)this), o);
+               }
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_TRANSIENT
+               #define FERRET_OBJECT_TRANSIENT
+                 namespace runtime {
+                   namespace type {
+                      const size_t transient = 3967;}}
+
+               #ifdef FERRET_STD_LIB
+               // Mutable builder for sequence, d_list, array_map, hash_map
+               // and sorted_map. Owned by the task or, outside of tasks, the
+               // thread that created it, persistent() hands out the
+               // immutable collection and the builder can not be used after
+               // that.
+               class transient final : public object {
+                 size_t target;
+                 bool done;
+               #if !defined(FERRET_DISABLE_MULTI_THREADING)
+                 ::std::thread::id owner;
+               #if defined(FERRET_POSIX)
+                 // A task may resume on another scheduler thread.
+                 task * owner_task;
+               #endif
+               #endif
+                 // List tail, hash trie root or sorted_map being built.
+                 var tail;
+                 // Pending elements or entries, array_map entries are kept
+                 // distinct, sorted_map ones are merged by flush().
+                 std_vector keys;
+                 std_vector values;
+
+                 static var build(std_vector const & v, var const & tail){
+                   var ret = tail;
+                   for(auto const& it : v)
+                     ret = runtime::make_cell(it, ret);
+                   return ret;
+                 }
+
+                 void check() const {
+                   if (done)
+                     throw ::std::logic_error("transient used after persistent");
+               #if !defined(FERRET_DISABLE_MULTI_THREADING)
+               #if defined(FERRET_POSIX)
+                   if (owner_task != nullptr){
+                     if (owner_task != task::current())
+                       throw ::std::logic_error("transient used by another task");
+                     return;
+                   }
+                   if (task::current() != nullptr)
+                     throw ::std::logic_error("transient used by another task");
+               #endif
+                   if (owner != ::std::this_thread::get_id())
+                     throw ::std::logic_error("transient used by another thread");
+               #endif
+                 }
+
+                 void insert(var const & k, var const & v){
+                   bool added;
+                   hash_trie::insert(tail, k, v, hash_trie::locate(tail.cast<hash_node>(), k), 0, added);
+                 }
+
+                 // Moves array_map entries into a trie once they outgrow
+                 // it, the way array_map::assoc promotes.
+                 void promote(){
+                   target = runtime::type::hash_map;
+                   tail = hash_trie::empty();
+                   for(size_t i = 0; i < keys.size(); i++)
+                     insert(keys[i], values[i]);
+                   keys.clear();
+                   values.clear();
+                 }
+
+                 void flush(){
+                   if (target != runtime::type::sorted_map || keys.empty())
+                     return;
+                   tail = tail.cast<sorted_map>()->assoc_all(keys, values);
+                   keys.clear();
+                   values.clear();
+                 }
+
+                 int index_of(var const & k) const {
+                   for(size_t i = 0; i < keys.size(); i++)
+                     if (keys[i] == k)
+                       return (int)i;
+                   return -1;
+                 }
+
+                 void start(){
+                   done = false;
+               #if !defined(FERRET_DISABLE_MULTI_THREADING)
+                   owner = ::std::this_thread::get_id();
+               #if defined(FERRET_POSIX)
+                   owner_task = task::current();
+               #endif
+               #endif
+                 }
+
+               public:
+
+                 size_t type() const final { return runtime::type::transient; }
+
+                 bool equals(var const & o) const final {
+                   return (this == o.get());
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("transient<");
+                   runtime::print(keys.size());
+                   runtime::print(">");
+                 }
+               #endif
+
+                 // Elements are kept in reverse list order, the back of the
+                 // vector becomes the head of the list.
+                 explicit transient(var const & coll = nil()) : target(runtime::type::sequence) {
+                   start();
+                   if (coll.is_nil() || coll.is_type(runtime::type::empty_sequence))
+                     return;
+
+                   if (coll.is_type(runtime::type::d_list)){
+                     target = runtime::type::d_list;
+                     keys = sequence::to<std_vector>(coll.cast<d_list>()->keys());
+                     values = sequence::to<std_vector>(coll.cast<d_list>()->vals());
+                     ::std::reverse(keys.begin(), keys.end());
+                     ::std::reverse(values.begin(), values.end());
+                   }else if (coll.is_type(runtime::type::array_map)){
+                     target = runtime::type::array_map;
+                     for(auto const& e : runtime::range(coll)){
+                       keys.push_back(runtime::first(e));
+                       values.push_back(runtime::first(runtime::rest(e)));
+                     }
+                   }else if (coll.is_type(runtime::type::hash_map)){
+                     target = runtime::type::hash_map;
+                     tail = coll.cast<hash_map>()->trie();
+                   }else if (coll.is_type(runtime::type::sorted_map)){
+                     target = runtime::type::sorted_map;
+                     tail = coll;
+                   }else{
+                     tail = coll;
+                   }
+                 }
+
+                 explicit transient(size_t t, size_t capacity) : target(t) {
+                   start();
+                   if (target == runtime::type::hash_map){
+                     tail = hash_trie::empty();
+                     return;
+                   }
+                   if (target == runtime::type::sorted_map)
+                     tail = obj<sorted_map>();
+                   keys.reserve(capacity);
+                   if (target != runtime::type::sequence)
+                     values.reserve(capacity);
+                 }
+
+                 // Elements or distinct keys so far.
+                 size_t count() {
+                   flush();
+                   if (target == runtime::type::hash_map)
+                     return tail.cast<hash_node>()->size;
+                   if (target == runtime::type::sorted_map)
+                     return tail.cast<sorted_map>()->count();
+                   return keys.size();
+                 }
+
+                 // Maps take a (key value) pair.
+                 transient & conj(var const & x){
+                   if (target != runtime::type::sequence)
+                     return assoc(runtime::first(x), runtime::first(runtime::rest(x)));
+                   check();
+                   keys.push_back(x);
+                   return *this;
+                 }
+
+                 // Like d_list::assoc the newest entry shadows older ones.
+                 transient & assoc(var const & k, var const & v){
+                   check();
+                   if (target == runtime::type::hash_map){
+                     insert(k, v);
+                     return *this;
+                   }
+                   if (target == runtime::type::array_map){
+                     int i = index_of(k);
+                     if (i != -1){
+                       values[(size_t)i] = v;
+                       return *this;
+                     }
+                     if (keys.size() == FERRET_ARRAY_MAP_SIZE){
+                       promote();
+                       insert(k, v);
+                       return *this;
+                     }
+                   }
+                   keys.push_back(k);
+                   values.push_back(v);
+                   return *this;
+                 }
+
+                 transient & dissoc(var const & k){
+                   check();
+                   if (target == runtime::type::sequence)
+                     throw ::std::logic_error("dissoc on a list transient");
+
+                   if (target == runtime::type::hash_map){
+                     var r = hash_trie::dissoc(tail.cast<hash_node>(), k, hash_trie::locate(tail.cast<hash_node>(), k), 0);
+                     if (!r.is_nil())
+                       tail = r;
+                     return *this;
+                   }
+
+                   if (target == runtime::type::sorted_map){
+                     flush();
+                     tail = tail.cast<sorted_map>()->dissoc(k);
+                     return *this;
+                   }
+
+                   size_t n = 0;
+                   for(size_t i = 0; i < keys.size(); i++)
+                     if (keys[i] != k){
+                       keys[n] = keys[i];
+                       values[n] = values[i];
+                       n++;
+                     }
+                   keys.resize(n);
+                   values.resize(n);
+                   return *this;
+                 }
+
+                 var persistent(){
+                   check();
+                   flush();
+                   var ret;
+                   if (target == runtime::type::d_list){
+                     if (keys.empty())
+                       ret = obj<d_list>();
+                     else
+                       ret = obj<d_list>(runtime::make_cell(build(keys, nil()), build(values, nil())));
+                   }else if (target == runtime::type::array_map){
+                     ret = array_map::from(keys, values);
+                   }else if (target == runtime::type::hash_map){
+                     ret = obj<hash_map>(tail);
+                   }else if (target == runtime::type::sorted_map){
+                     ret = tail;
+                   }else{
+                     ret = build(keys, tail);
+                   }
+
+                   done = true;
+                   keys.clear();
+                   values.clear();
+                   tail = nil();
+                   return ret;
+                 }
+               };
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_INTEGER_RANGE
+               #define FERRET_OBJECT_INTEGER_RANGE
+                 namespace runtime {
+                   namespace type {
+                      const size_t integer_range = 3990;}}
+
+               // Arithmetic progression start, start + step, ... computed on
+               // demand. Elements are start + i * step, so nth and count
+               // are O(1) and long ranges do not drift. An endless range
+               // has no count.
+               class integer_range final : public object, public seekable_i {
+                 const real_t _start;
+                 const real_t _step;
+                 const size_t _count;
+                 const bool _endless;
+
+               public:
+
+                 size_t type() const final { return runtime::type::integer_range; }
+
+                 bool equals(var const & o) const final {
+                   if (o.is_type(runtime::type::integer_range)){
+                     integer_range * r = o.cast<integer_range>();
+                     if (!_endless && !r->_endless)
+                       return (_count == r->_count &&
+                               (_count == 0 ||
+                                (nth(0) == r->nth(0) && nth(_count - 1) == r->nth(_count - 1))));
+                   }
+
+                   var other = o;
+                   for(size_t i = 0; _endless || i < _count; i++){
+                     if (other.is_nil() || other.is_type(runtime::type::empty_sequence))
+                       return false;
+                     if (nth(i) != runtime::first(other))
+                       return false;
+                     other = runtime::rest(other);
+                   }
+                   return (other.is_nil() || other.is_type(runtime::type::empty_sequence));
+                 }
+
+                 size_t hash() const final { return runtime::hash_ordered(var((object*)this)); }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("(");
+                   for(size_t i = 0; _endless || i < _count; i++){
+                     if (i != 0)
+                       runtime::print(" ");
+                     runtime::print(at(i));
+                   }
+                   runtime::print(")");
+                 }
+               #endif
+
+                 integer_range(real_t start, real_t step, size_t count, bool endless = false) :
+                   _start(start), _step(step), _count(count), _endless(endless) { }
+
+                 // Numbers from start up to, not including, end. Empty
+                 // ranges are the empty list.
+                 static var from(real_t start, real_t end, real_t step = 1){
+                   if (step == 0)
+                     return (start < end) ? endless(start, 0) : runtime::list();
+                   real_t span = (end - start) / step;
+                   if (!(span > 0))
+                     return runtime::list();
+                   // An infinite end, or more elements than a size_t can
+                   // count, which could never be walked to the end anyway.
+                   if (span >= (real_t)(SIZE_MAX / 2))
+                     return endless(start, step);
+                   size_t n = (size_t)span;
+                   if ((real_t)n < span)
+                     n++;
+                   return obj<integer_range>(start, step, n);
+                 }
+
+                 static var endless(real_t start = 0, real_t step = 1){
+                   return obj<integer_range>(start, step, 0, true);
+                 }
+
+                 real_t at(size_t i) const { return _start + (real_t)i * _step; }
+
+                 // nil past the end.
+                 var nth(size_t i) const {
+                   if (!_endless && i >= _count)
+                     return nil();
+                   return obj<number>(at(i));
+                 }
+
+                 var nthrest(size_t i) const {
+                   if (_endless)
+                     return obj<integer_range>(at(i), _step, 0, true);
+                   if (i >= _count)
+                     return runtime::list();
+                   return obj<integer_range>(at(i), _step, _count - i);
+                 }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return runtime::make_cell(x, var(this));
+                 }
+
+                 var first() const final {
+                   return nth(0);
+                 }
+
+                 var rest() const final {
+                   return nthrest(1);
+                 }
+
+                 bool reducible() const final { return true; }
+
+                 // A counted loop, the only allocation per step is the
+                 // boxed number handed to the reducer.
+                 bool reduce(reducer_i & rf, var & acc) const final {
+                   for(size_t i = 0; _endless || i < _count; i++)
+                     if (!rf.step(acc, obj<number>(at(i))))
+                       return false;
+                   return true;
+                 }
+
+                 bool counted(size_t & n) const final {
+                   n = _count;
+                   return !_endless;
+                 }
+               };
+               #endif
+         #ifndef FERRET_OBJECT_TEXT_VIEW
+               #define FERRET_OBJECT_TEXT_VIEW
+
+               #ifdef FERRET_STD_LIB
+               // Characters of a text laid out contiguously for the text
+               // kernels. Slices are read in place, anything else is
+               // flattened once.
+               class text_view {
+                 ::std::string storage;
+                 const char * _data;
+                 size_t _size;
+               public:
+
+                 explicit text_view(var const & v){
+                   if (!v.is_nil() && v.is_type(runtime::type::string_slice)){
+                     string_slice * s = v.cast<string_slice>();
+                     _data = s->begin();
+                     _size = s->length();
+                     return;
+                   }
+
+                   if (v.is_nil()){
+                   }else if (v.is_type(runtime::type::string) || v.is_type(runtime::type::rope)){
+                     storage = string::to<::std::string>(v);
+                   }else if (v.is_type(runtime::type::number)){
+                     storage = ::std::string(1, number::to<char>(v));
+                   }else{
+                     for(auto const& c : runtime::range(v))
+                       storage += number::to<char>(c);
+                   }
+                   _data = storage.data();
+                   _size = storage.size();
+                 }
+
+                 text_view(text_view const &) = delete;
+
+                 const char * data() const { return _data; }
+                 size_t size() const { return _size; }
+               };
+
+               namespace runtime {
+                 inline bool is_utf8(var const & s){
+                   text_view t(s);
+                   return text::is_utf8(t.data(), t.size());
+                 }
+
+                 // Index of the first x in s, x is either a character or a
+                 // text. nil when there is none.
+                 inline var index_of(var const & s, var const & x){
+                   text_view t(s);
+                   text_view w(x);
+                   size_t i = text::find(t.data(), t.size(), w.data(), w.size());
+                   if (i == text::npos)
+                     return nil();
+                   return obj<number>(i);
+                 }
+
+                 inline bool starts_with(var const & s, var const & prefix){
+                   text_view t(s);
+                   text_view p(prefix);
+                   return text::starts_with(t.data(), t.size(), p.data(), p.size());
+                 }
+
+                 inline int compare_text(var const & a, var const & b){
+                   text_view l(a);
+                   text_view r(b);
+                   return text::compare(l.data(), l.size(), r.data(), r.size());
+                 }
+
+                 // Number written in s, nil unless all of s is one.
+                 inline var parse_number(var const & s){
+                   text_view t(s);
+                   double d;
+                   const char * end = t.data() + t.size();
+                   if (t.size() == 0 || decimal::parse(t.data(), end, d) != end)
+                     return nil();
+                   return obj<number>(d);
+                 }
+               }
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_SERIAL
+               #define FERRET_OBJECT_SERIAL
+
+               #ifdef FERRET_STD_LIB
+               #if !defined(FERRET_SERIAL_BUFFER_SIZE)
+                 # define FERRET_SERIAL_BUFFER_SIZE 65536
+               #endif
+               #if !defined(FERRET_SERIAL_INITIAL_SIZE)
+                 # define FERRET_SERIAL_INITIAL_SIZE 256
+               #endif
+               #if !defined(FERRET_SERIAL_MAX_DEPTH)
+                 # define FERRET_SERIAL_MAX_DEPTH 1024
+               #endif
+
+               // Binary form of runtime values. Every value is a tag byte
+               // followed by its payload: integers and keywords as zigzag
+               // varints, other numbers as little endian doubles, texts as a
+               // varint length and the bytes, collections as a varint count
+               // and their elements. d_lists keep shadowed entries so they
+               // decode to the same map.
+               namespace serial {
+                 enum tag : unsigned char {
+                   nil_tag = 0, false_tag, true_tag, integer_tag, real_tag, keyword_tag, string_tag,
+                   list_tag, d_list_tag, map_tag, set_tag, sorted_map_tag, sorted_set_tag
+                 };
+
+                 inline uint64_t zigzag(int64_t x){ return ((uint64_t)x << 1) ^ (uint64_t)(x >> 63); }
+                 inline int64_t unzigzag(uint64_t x){ return (int64_t)(x >> 1) ^ -(int64_t)(x & 1); }
+
+                 // Writes into a byte_block, which is either handed out by
+                 // bytes() or, given a file descriptor, flushed to it
+                 // whenever it fills up. Without a descriptor the block
+                 // starts at FERRET_SERIAL_INITIAL_SIZE and doubles.
+                 class encoder {
+                   var block;
+                   char * buffer;
+                   size_t capacity;
+                   size_t used;
+                   int fd;
+
+                   void reserve(size_t n){
+                     if (used + n <= capacity)
+                       return;
+                     if (fd != -1){
+                       flush();
+                       if (n <= capacity)
+                         return;
+                     }
+                     size_t size = ::std::max(::std::max(capacity * 2, (size_t)FERRET_SERIAL_INITIAL_SIZE),
+                                              used + n);
+                     var next = obj<byte_block>(size);
+                     if (used != 0)
+                       ::memcpy(next.cast<byte_block>()->data(), buffer, used);
+                     block = next;
+                     buffer = block.cast<byte_block>()->data();
+                     capacity = size;
+                   }
+
+                   void put(unsigned char c){
+                     reserve(1);
+                     buffer[used++] = (char)c;
+                   }
+
+                   void put(const char * p, size_t n){
+                     reserve(n);
+                     ::memcpy(buffer + used, p, n);
+                     used += n;
+                   }
+
+                   void varint(uint64_t x){
+                     reserve(10);
+                     while (x >= 0x80){
+                       buffer[used++] = (char)(x | 0x80);
+                       x >>= 7;
+                     }
+                     buffer[used++] = (char)x;
+                   }
+
+                   void write_number(double d){
+                     if (d == ::floor(d) && ::fabs(d) < 9007199254740992.0){
+                       put(integer_tag);
+                       varint(zigzag((int64_t)d));
+                       return;
+                     }
+                     uint64_t bits;
+                     ::memcpy(&bits, &d, sizeof(bits));
+                     put(real_tag);
+                     reserve(8);
+                     for(int i = 0; i < 8; i++)
+                       buffer[used++] = (char)(bits >> (8 * i));
+                   }
+
+                   // Writes the elements of a collection, or the key and
+                   // value of each map entry, driven by the collection.
+                   struct writer final : public reducer_i {
+                     encoder & out;
+                     const bool entries;
+                     bool ok;
+
+                     writer(encoder & e, bool kv) : out(e), entries(kv), ok(true) { }
+
+                     bool step(var & , var const & x) final {
+                       if (entries)
+                         ok = out.write(runtime::first(x)) && out.write(runtime::first(runtime::rest(x)));
+                       else
+                         ok = out.write(x);
+                       return ok;
+                     }
+                   };
+
+                   bool pairs(var const & m){
+                     writer w(*this, true);
+                     var acc;
+                     runtime::reduce(w, acc, m);
+                     return w.ok;
+                   }
+
+                   bool elements(var const & coll){
+                     writer w(*this, false);
+                     var acc;
+                     runtime::reduce(w, acc, coll);
+                     return w.ok;
+                   }
+
+                 public:
+
+                   // Size zero picks FERRET_SERIAL_BUFFER_SIZE when flushing
+                   // to f and FERRET_SERIAL_INITIAL_SIZE otherwise.
+                   explicit encoder(int f = -1, size_t size = 0) :
+                     capacity(size), used(0), fd(f) {
+                     if (capacity == 0)
+                       capacity = (fd == -1) ? FERRET_SERIAL_INITIAL_SIZE : FERRET_SERIAL_BUFFER_SIZE;
+                     block = obj<byte_block>(capacity);
+                     buffer = block.cast<byte_block>()->data();
+                   }
+
+                   encoder(encoder const &) = delete;
+
+                   ~encoder(){ flush(); }
+
+                   // False for values with no binary form (lambdas, atoms,
+                   // endless sequences, sorted collections with a custom
+                   // comparator, ...), the output is then incomplete.
+                   bool write(var const & v){
+                     if (v.is_nil()){
+                       put(nil_tag);
+                       return true;
+                     }
+
+                     size_t t = v.get()->type();
+
+                     if (t == runtime::type::boolean){
+                       put(v.cast<boolean>()->container() ? true_tag : false_tag);
+                       return true;
+                     }
+
+                     if (t == runtime::type::number){
+                       write_number(number::to<double>(v));
+                       return true;
+                     }
+
+                     if (t == runtime::type::keyword){
+                       put(keyword_tag);
+                       varint(zigzag((int64_t)v.cast<keyword>()->word()));
+                       return true;
+                     }
+
+                     if (t == runtime::type::string || t == runtime::type::rope ||
+                         t == runtime::type::string_slice){
+                       text_view s(v);
+                       put(string_tag);
+                       varint(s.size());
+                       put(s.data(), s.size());
+                       return true;
+                     }
+
+                     if (t == runtime::type::d_list){
+                       d_list * d = v.cast<d_list>();
+                       size_t n = 0;
+                       for(auto const& it : runtime::range_pair(d->keys(), d->vals())){
+                         if (it.first.is_nil())
+                           break;
+                         n++;
+                       }
+                       put(d_list_tag);
+                       varint(n);
+                       for(auto const& it : runtime::range_pair(d->keys(), d->vals())){
+                         if (n-- == 0)
+                           break;
+                         if (!write(it.first) || !write(it.second))
+                           return false;
+                       }
+                       return true;
+                     }
+
+                     if (t == runtime::type::array_map || t == runtime::type::hash_map){
+                       put(map_tag);
+                       varint(runtime::map_count(v));
+                       return pairs(v);
+                     }
+
+                     if (t == runtime::type::hash_set){
+                       put(set_tag);
+                       varint(v.cast<hash_set>()->count());
+                       return elements(v);
+                     }
+
+                     if (t == runtime::type::sorted_map || t == runtime::type::sorted_set){
+                       var cmp = (t == runtime::type::sorted_map) ?
+                         v.cast<sorted_map>()->comparator() : v.cast<sorted_set>()->comparator();
+                       if (!cmp.is_nil())
+                         return false;
+                       put((t == runtime::type::sorted_map) ? sorted_map_tag : sorted_set_tag);
+                       varint(runtime::count(v));
+                       return (t == runtime::type::sorted_map) ? pairs(v) : elements(v);
+                     }
+
+                     size_t n;
+                     if (t == runtime::type::integer_range && !runtime::known_count(v, n))
+                       return false;
+
+                     if (runtime::is_seqable(v) || t == runtime::type::empty_sequence){
+                       put(list_tag);
+                       varint(runtime::count(v));
+                       return elements(v);
+                     }
+
+                     return false;
+                   }
+
+                   // False if the descriptor refused the bytes.
+                   bool flush(){
+                     if (fd == -1)
+                       return true;
+                 #if defined(FERRET_POSIX)
+                     size_t done = 0;
+                     while (done < used){
+                       ssize_t n = ::write(fd, buffer + done, used - done);
+                       if (n < 0 && errno == EINTR)
+                         continue;
+                       if (n <= 0){
+                         used = 0;
+                         return false;
+                       }
+                       done += (size_t)n;
+                     }
+                 #endif
+                     used = 0;
+                     return true;
+                   }
+
+                   size_t size() const { return used; }
+
+                   // Encoded bytes so far, as a slice sharing the buffer.
+                   // Writing more afterwards starts a new buffer and leaves
+                   // the slice as it is.
+                   var bytes(){
+                     var ret = obj<string_slice>(block, buffer, used);
+                     block = nil();
+                     buffer = nullptr;
+                     capacity = 0;
+                     used = 0;
+                     return ret;
+                   }
+                 };
+
+                 // Reads values back from bytes owned by another object.
+                 // Strings come out as slices of those bytes, the owner is
+                 // kept alive by them instead of being copied.
+                 class decoder {
+                   var owner;
+                   const char * p;
+                   const char * end;
+                   size_t depth;
+                   bool _ok;
+
+                   var fail(){
+                     _ok = false;
+                     p = end;
+                     return nil();
+                   }
+
+                   bool varint(uint64_t & x){
+                     x = 0;
+                     for(int shift = 0; shift < 64 && p < end; shift += 7){
+                       unsigned char c = (unsigned char)*p++;
+                       x |= (uint64_t)(c & 0x7F) << shift;
+                       if (c < 0x80)
+                         return true;
+                     }
+                     return false;
+                   }
+
+                   // Counts are checked against the bytes left, every
+                   // element takes at least one.
+                   bool count(size_t & n){
+                     uint64_t x;
+                     if (!varint(x) || x > (uint64_t)(end - p))
+                       return false;
+                     n = (size_t)x;
+                     return true;
+                   }
+
+                 public:
+
+                   decoder(var const & o, const char * data, size_t size) :
+                     owner(o), p(data), end(data + size), depth(0), _ok(true) { }
+
+                   bool ok() const { return _ok; }
+                   bool done() const { return (p == end); }
+
+                   // nil, with ok() false, on malformed input or nesting
+                   // deeper than FERRET_SERIAL_MAX_DEPTH.
+                   var read(){
+                     if (p == end || depth == FERRET_SERIAL_MAX_DEPTH)
+                       return fail();
+                     depth++;
+                     var v = value();
+                     depth--;
+                     return v;
+                   }
+
+                 private:
+
+                   var value(){
+                     unsigned char t = (unsigned char)*p++;
+                     uint64_t x;
+                     size_t n;
+
+                     switch(t){
+                     case nil_tag:
+                       return nil();
+                     case false_tag:
+                       return obj<boolean>(false);
+                     case true_tag:
+                       return obj<boolean>(true);
+                     case integer_tag:
+                       if (!varint(x))
+                         return fail();
+                       return obj<number>((double)unzigzag(x));
+                     case real_tag:{
+                       if (end - p < 8)
+                         return fail();
+                       uint64_t bits = 0;
+                       for(int i = 0; i < 8; i++)
+                         bits |= (uint64_t)(unsigned char)p[i] << (8 * i);
+                       p += 8;
+                       double d;
+                       ::memcpy(&d, &bits, sizeof(d));
+                       return obj<number>(d);
+                     }
+                     case keyword_tag:
+                       if (!varint(x))
+                         return fail();
+                       return obj<keyword>((number_t)unzigzag(x));
+                     case string_tag:{
+                       if (!varint(x) || x > (uint64_t)(end - p))
+                         return fail();
+                       var s = obj<string_slice>(owner, p, (size_t)x);
+                       p += x;
+                       return s;
+                     }
+                     case list_tag:{
+                       if (!count(n))
+                         return fail();
+                       if (n == 0)
+                         return runtime::list();
+                       std_vector items;
+                       items.reserve(n);
+                       for(size_t i = 0; i < n && _ok; i++)
+                         items.push_back(read());
+                       if (!_ok)
+                         return nil();
+                       var ret;
+                       for(size_t i = n; i > 0; i--)
+                         ret = runtime::make_cell(items[i - 1], ret);
+                       return ret;
+                     }
+                     case d_list_tag:{
+                       if (!count(n))
+                         return fail();
+                       std_vector keys;
+                       std_vector vals;
+                       keys.reserve(n);
+                       vals.reserve(n);
+                       for(size_t i = 0; i < n && _ok; i++){
+                         keys.push_back(read());
+                         vals.push_back(read());
+                       }
+                       if (!_ok)
+                         return nil();
+                       transient m(runtime::type::d_list, n);
+                       for(size_t i = n; i > 0; i--)
+                         m.assoc(keys[i - 1], vals[i - 1]);
+                       return m.persistent();
+                     }
+                     case map_tag:
+                     case sorted_map_tag:{
+                       if (!count(n))
+                         return fail();
+                       size_t target = runtime::type::hash_map;
+                       if (t == sorted_map_tag)
+                         target = runtime::type::sorted_map;
+                       else if (n <= FERRET_ARRAY_MAP_SIZE)
+                         target = runtime::type::array_map;
+                       transient m(target, n);
+                       for(size_t i = 0; i < n && _ok; i++){
+                         var k = read();
+                         var v = read();
+                         m.assoc(k, v);
+                       }
+                       return _ok ? m.persistent() : nil();
+                     }
+                     case set_tag:
+                     case sorted_set_tag:{
+                       if (!count(n))
+                         return fail();
+                       var s = (t == set_tag) ? obj<hash_set>() : obj<sorted_set>();
+                       for(size_t i = 0; i < n && _ok; i++){
+                         if (t == set_tag)
+                           s = s.cast<hash_set>()->conj(read());
+                         else
+                           s = s.cast<sorted_set>()->conj(read());
+                       }
+                       return _ok ? s : nil();
+                     }
+                     }
+                     return fail();
+                   }
+                 };
+               }
+
+               namespace runtime {
+                 // Bytes of v as a string_slice, nil if v has no binary form.
+                 inline var serialize(var const & v){
+                   serial::encoder e;
+                   if (!e.write(v))
+                     return nil();
+                   return e.bytes();
+                 }
+
+                 // Strings in the result share the bytes when they are a
+                 // slice or a mapped file, other texts are copied once.
+                 inline var deserialize(var const & bytes){
+                   var owner = bytes;
+                   const char * data = nullptr;
+                   size_t size = 0;
+                   if (!bytes.is_nil() && bytes.is_type(type::string_slice)){
+                     data = bytes.cast<string_slice>()->begin();
+                     size = bytes.cast<string_slice>()->length();
+                 #if defined(FERRET_POSIX)
+                   }else if (!bytes.is_nil() && bytes.is_type(type::mapped_file)){
+                     data = bytes.cast<mapped_file>()->data();
+                     size = bytes.cast<mapped_file>()->size();
+                 #endif
+                   }else{
+                     text_view t(bytes);
+                     owner = obj<byte_block>(t.size());
+                     data = owner.cast<byte_block>()->data();
+                     size = t.size();
+                     ::memcpy((char *)data, t.data(), size);
+                   }
+                   serial::decoder d(owner, data, size);
+                   var v = d.read();
+                   return (d.ok() && d.done()) ? v : nil();
+                 }
+               }
+               #endif
+               #endif
+         #ifndef FERRET_OBJECT_EDN
+               #define FERRET_OBJECT_EDN
+                 namespace runtime {
+                   namespace type {
+                      const size_t edn_reader = 3992;
+                      const size_t edn_sequence = 3993;}}
+
+               #ifdef FERRET_STD_LIB
+               #if !defined(FERRET_EDN_MAX_DEPTH)
+                 # define FERRET_EDN_MAX_DEPTH 1024
+               #endif
+               #if !defined(FERRET_IO_BLOCK_SIZE)
+                 # define FERRET_IO_BLOCK_SIZE 1_MB
+               #endif
+
+               namespace edn {
+                 inline bool is_space(char c){
+                   return (c == ' ' || c == ',' || c == '\n' || c == '\t' || c == '\r');
+                 }
+
+                 inline bool is_delimiter(char c){
+                   return (is_space(c) || c == '(' || c == ')' || c == '[' || c == ']' ||
+                           c == '{' || c == '}' || c == '"' || c == ';');
+                 }
+
+               #if defined(FERRET_SIMD)
+                 inline uint32_t space_mask(simd::block b){
+                   return (simd::equal(b, simd::splat(' ')) | simd::equal(b, simd::splat(',')) |
+                           simd::equal(b, simd::splat('\n')) | simd::equal(b, simd::splat('\t')) |
+                           simd::equal(b, simd::splat('\r')));
+                 }
+               #endif
+
+                 inline const char * skip_space(const char * p, const char * end){
+               #if defined(FERRET_SIMD)
+                   for(; (size_t)(end - p) >= simd::width; p += simd::width){
+                     uint32_t m = space_mask(simd::load(p)) ^ simd::all;
+                     if (m != 0)
+                       return p + __builtin_ctz(m);
+                   }
+               #endif
+                   while (p < end && is_space(*p))
+                     p++;
+                   return p;
+                 }
+
+                 inline const char * token_end(const char * p, const char * end){
+               #if defined(FERRET_SIMD)
+                   for(; (size_t)(end - p) >= simd::width; p += simd::width){
+                     simd::block b = simd::load(p);
+                     uint32_t m = (space_mask(b) |
+                                   simd::equal(b, simd::splat('(')) | simd::equal(b, simd::splat(')')) |
+                                   simd::equal(b, simd::splat('[')) | simd::equal(b, simd::splat(']')) |
+                                   simd::equal(b, simd::splat('{')) | simd::equal(b, simd::splat('}')) |
+                                   simd::equal(b, simd::splat('"')) | simd::equal(b, simd::splat(';')));
+                     if (m != 0)
+                       return p + __builtin_ctz(m);
+                   }
+               #endif
+                   while (p < end && !is_delimiter(*p))
+                     p++;
+                   return p;
+                 }
+
+                 // Closing quote or the next escape.
+                 inline const char * string_end(const char * p, const char * end){
+               #if defined(FERRET_SIMD)
+                   for(; (size_t)(end - p) >= simd::width; p += simd::width){
+                     simd::block b = simd::load(p);
+                     uint32_t m = (simd::equal(b, simd::splat('"')) |
+                                   simd::equal(b, simd::splat('\\')));
+                     if (m != 0)
+                       return p + __builtin_ctz(m);
+                   }
+               #endif
+                   while (p < end && *p != '"' && *p != '\\')
+                     p++;
+                   return p;
+                 }
+
+                 inline bool hex4(const char * p, uint32_t & x){
+                   x = 0;
+                   for(int i = 0; i < 4; i++){
+                     char c = p[i];
+                     x <<= 4;
+                     if (c >= '0' && c <= '9')
+                       x |= (uint32_t)(c - '0');
+                     else if (c >= 'a' && c <= 'f')
+                       x |= (uint32_t)(c - 'a' + 10);
+                     else if (c >= 'A' && c <= 'F')
+                       x |= (uint32_t)(c - 'A' + 10);
+                     else
+                       return false;
+                   }
+                   return true;
+                 }
+
+                 inline char * put_utf8(char * out, uint32_t c){
+                   if (c < 0x80){
+                     *out++ = (char)c;
+                   }else if (c < 0x800){
+                     *out++ = (char)(0xC0 | (c >> 6));
+                     *out++ = (char)(0x80 | (c & 0x3F));
+                   }else if (c < 0x10000){
+                     *out++ = (char)(0xE0 | (c >> 12));
+                     *out++ = (char)(0x80 | ((c >> 6) & 0x3F));
+                     *out++ = (char)(0x80 | (c & 0x3F));
+                   }else{
+                     *out++ = (char)(0xF0 | (c >> 18));
+                     *out++ = (char)(0x80 | ((c >> 12) & 0x3F));
+                     *out++ = (char)(0x80 | ((c >> 6) & 0x3F));
+                     *out++ = (char)(0x80 | (c & 0x3F));
+                   }
+                   return out;
+                 }
+
+                 enum status { ok, incomplete, malformed };
+
+                 // Recursive descent over the bytes of owner in [p, end).
+                 // Running out of input is incomplete unless the input is
+                 // final, the caller then reads more and parses the form
+                 // again from its start. Collections are gathered first and
+                 // built in one go, strings without escapes are slices of
+                 // the input.
+                 //
+                 // Lists and vectors read as lists, maps as d_lists, sets
+                 // as hash sets and characters as numbers. Tags are dropped
+                 // and symbols other than nil, true and false read as
+                 // strings. A keyword has the word keyword(":name") would
+                 // give it.
+                 class parser {
+                   const var owner;
+                   const char * p;
+                   const char * const end;
+                   const bool last;
+                   status state;
+                   size_t depth;
+
+                   var stop(status s){
+                     if (state == ok)
+                       state = s;
+                     p = end;
+                     return nil();
+                   }
+
+                   var short_input(){
+                     return stop(last ? malformed : incomplete);
+                   }
+
+                   static var list_of(std_vector const & items){
+                     if (items.empty())
+                       return runtime::list();
+                     var ret;
+                     for(size_t i = items.size(); i > 0; i--)
+                       ret = runtime::make_cell(items[i - 1], ret);
+                     return ret;
+                   }
+
+                   // Elements up to close, false if the input ended first.
+                   bool elements(char close, std_vector & items){
+                     if (++depth > FERRET_EDN_MAX_DEPTH){
+                       stop(malformed);
+                       return false;
+                     }
+                     for(;;){
+                       if (!skip()){
+                         if (state == ok)
+                           short_input();
+                         return false;
+                       }
+                       if (*p == close){
+                         p++;
+                         depth--;
+                         return true;
+                       }
+                       items.push_back(form());
+                       if (state != ok)
+                         return false;
+                     }
+                   }
+
+                   var map_form(){
+                     std_vector items;
+                     if (!elements('}', items))
+                       return nil();
+                     if (items.size() % 2 != 0)
+                       return stop(malformed);
+                     if (items.empty())
+                       return obj<d_list>();
+                     transient m(runtime::type::d_list, items.size() / 2);
+                     for(size_t i = items.size(); i > 0; i -= 2)
+                       m.assoc(items[i - 2], items[i - 1]);
+                     return m.persistent();
+                   }
+
+                   var set_form(){
+                     std_vector items;
+                     if (!elements('}', items))
+                       return nil();
+                     var s = obj<hash_set>();
+                     for(auto const& it : items)
+                       s = s.cast<hash_set>()->conj(it);
+                     return s;
+                   }
+
+                   var string_form(){
+                     const char * b = ++p;
+                     const char * q = string_end(b, end);
+                     if (q == end)
+                       return short_input();
+                     if (*q == '"'){
+                       p = q + 1;
+                       return obj<string_slice>(owner, b, (size_t)(q - b));
+                     }
+
+                     // Escaped, find the closing quote to size the copy.
+                     const char * e = q;
+                     for(;;){
+                       e = string_end(e, end);
+                       if (e == end)
+                         return short_input();
+                       if (*e == '"')
+                         break;
+                       if (end - e < 2)
+                         return short_input();
+                       e += 2;
+                     }
+
+                     var block = obj<byte_block>((size_t)(e - b));
+                     char * const start = block.cast<byte_block>()->data();
+                     char * out = start;
+                     for(const char * s = b; s < e; ){
+                       if (*s != '\\'){
+                         *out++ = *s++;
+                         continue;
+                       }
+                       char c = s[1];
+                       s += 2;
+                       switch(c){
+                       case 'n': *out++ = '\n'; break;
+                       case 't': *out++ = '\t'; break;
+                       case 'r': *out++ = '\r'; break;
+                       case 'b': *out++ = '\b'; break;
+                       case 'f': *out++ = '\f'; break;
+                       case '"': case '\\': case '/': *out++ = c; break;
+                       case 'u':{
+                         uint32_t x;
+                         if (e - s < 4 || !hex4(s, x))
+                           return stop(malformed);
+                         s += 4;
+                         uint32_t low;
+                         if (x >= 0xD800 && x < 0xDC00 && e - s >= 6 && s[0] == '\\' && s[1] == 'u' &&
+                             hex4(s + 2, low) && low >= 0xDC00 && low < 0xE000){
+                           x = 0x10000 + ((x - 0xD800) << 10) + (low - 0xDC00);
+                           s += 6;
+                         }
+                         out = put_utf8(out, x);
+                         break;
+                       }
+                       default:
+                         return stop(malformed);
+                       }
+                     }
+                     p = e + 1;
+                     return obj<string_slice>(block, start, (size_t)(out - start));
+                   }
+
+                   var character_form(){
+                     if (end - p < 2)
+                       return short_input();
+                     const char * b = p + 1;
+                     const char * e = token_end(b + 1, end);
+                     if (e == end && !last)
+                       return short_input();
+                     size_t n = (size_t)(e - b);
+                     p = e;
+                     uint32_t x;
+                     if (n == 1)
+                       return obj<ferret::number>((number_t)*b);
+                     if (n == 5 && b[0] == 'u' && hex4(b + 1, x))
+                       return obj<ferret::number>((number_t)x);
+                     static const struct { const char * name; char c; } names[] = {
+                       {"newline", '\n'}, {"space", ' '}, {"tab", '\t'},
+                       {"return", '\r'}, {"formfeed", '\f'}, {"backspace", '\b'}};
+                     for(auto const& it : names)
+                       if (::strlen(it.name) == n && ::memcmp(it.name, b, n) == 0)
+                         return obj<ferret::number>((number_t)it.c);
+                     return stop(malformed);
+                   }
+
+                   // N and M suffixes are accepted and ignored.
+                   var number_form(const char * b, const char * e){
+                     double d;
+                     const char * s = decimal::parse(b, e, d);
+                     if (s != e && !(s + 1 == e && (*s == 'N' || *s == 'M')))
+                       return stop(malformed);
+                     return obj<ferret::number>(d);
+                   }
+
+                   var token_form(){
+                     const char * b = p;
+                     const char * e = token_end(p, end);
+                     if (e == end && !last)
+                       return short_input();
+                     p = e;
+                     size_t n = (size_t)(e - b);
+
+                     if (*b == ':'){
+                       number_t word = 0;
+                       for(const char * s = b; s < e; s++)
+                         word += (number_t)*s;
+                       return obj<keyword>(word);
+                     }
+
+                     if ((*b >= '0' && *b <= '9') ||
+                         (n > 1 && (*b == '-' || *b == '+') && b[1] >= '0' && b[1] <= '9'))
+                       return number_form(b, e);
+
+                     if (n == 3 && ::memcmp(b, "nil", 3) == 0)
+                       return nil();
+                     if (n == 4 && ::memcmp(b, "true", 4) == 0)
+                       return obj<boolean>(true);
+                     if (n == 5 && ::memcmp(b, "false", 5) == 0)
+                       return obj<boolean>(false);
+                     return obj<string_slice>(owner, b, n);
+                   }
+
+                   // ##Inf, ##-Inf and ##NaN.
+                   var symbolic(){
+                     const char * b = ++p;
+                     const char * e = token_end(p, end);
+                     if (e == end && !last)
+                       return short_input();
+                     p = e;
+                     size_t n = (size_t)(e - b);
+                     if (n == 3 && ::memcmp(b, "Inf", 3) == 0)
+                       return obj<ferret::number>(HUGE_VAL);
+                     if (n == 4 && ::memcmp(b, "-Inf", 4) == 0)
+                       return obj<ferret::number>(-HUGE_VAL);
+                     if (n == 3 && ::memcmp(b, "NaN", 3) == 0)
+                       return obj<ferret::number>(NAN);
+                     return stop(malformed);
+                   }
+
+                 public:
+
+                   parser(var const & o, const char * b, const char * e, bool final) :
+                     owner(o), p(b), end(e), last(final), state(ok), depth(0) { }
+
+                   status result() const { return state; }
+                   const char * position() const { return p; }
+
+                   // Moves past whitespace, comments and discarded forms,
+                   // false when there is no form left in the input.
+                   bool skip(){
+                     for(;;){
+                       p = skip_space(p, end);
+                       if (p == end)
+                         return false;
+                       if (*p == ';'){
+                         const char * nl = (const char *)::memchr(p, '\n', (size_t)(end - p));
+                         if (nl == nullptr){
+                           if (last)
+                             p = end;
+                           else
+                             short_input();
+                           return false;
+                         }
+                         p = nl + 1;
+                       }else if (*p == '#'){
+                         if (end - p < 2){
+                           short_input();
+                           return false;
+                         }
+                         if (p[1] != '_')
+                           return true;
+                         p += 2;
+                         form();
+                         if (state != ok)
+                           return false;
+                       }else{
+                         return true;
+                       }
+                     }
+                   }
+
+                   var form(){
+                     if (!skip())
+                       return (state == ok) ? short_input() : nil();
+
+                     std_vector items;
+                     switch(*p){
+                     case '(':
+                     case '[':
+                       p++;
+                       if (!elements((p[-1] == '(') ? ')' : ']', items))
+                         return nil();
+                       return list_of(items);
+                     case '{':
+                       p++;
+                       return map_form();
+                     case '"':
+                       return string_form();
+                     case '\\':
+                       return character_form();
+                     case ')': case ']': case '}':
+                       return stop(malformed);
+                     case '#':
+                       p++;
+                       if (*p == '{'){
+                         p++;
+                         return set_form();
+                       }
+                       if (*p == '#')
+                         return symbolic();
+                       token_form();
+                       if (state != ok)
+                         return nil();
+                       return form();
+                     }
+                     return token_form();
+                   }
+                 };
+               }
+
+               // Top level forms of a text, or of a file descriptor read in
+               // large blocks. A form crossing a block boundary is carried
+               // over to the front of the next block, which grows for forms
+               // larger than a block.
+               class edn_reader final : public object {
+                 const int fd;
+                 var owner;
+                 const char * data;
+                 size_t pos;
+                 size_t end;
+                 bool eof;
+                 bool failed;
+                 mutex lock;
+
+                 void refill(){
+               #if defined(FERRET_POSIX)
+                   size_t carry = end - pos;
+                   size_t capacity = FERRET_IO_BLOCK_SIZE;
+                   while (capacity < carry * 2)
+                     capacity *= 2;
+
+                   var next;
+                   if (owner.is_unique() && owner.cast<byte_block>()->capacity() >= capacity)
+                     next = owner;
+                   else
+                     next = obj<byte_block>(capacity);
+
+                   char * buffer = next.cast<byte_block>()->data();
+                   if (carry != 0)
+                     ::memmove(buffer, data + pos, carry);
+
+                   owner = next;
+                   data = buffer;
+                   pos = 0;
+                   end = carry;
+                   capacity = owner.cast<byte_block>()->capacity();
+
+                   // At least twice the carried over bytes, so a large form
+                   // is parsed a logarithmic number of times.
+                   while (end < capacity){
+                     ssize_t n = ::read(fd, buffer + end, capacity - end);
+                     if (n < 0 && errno == EINTR)
+                       continue;
+                     if (n <= 0){
+                       eof = true;
+                       break;
+                     }
+                     end += (size_t)n;
+                     if (end >= carry * 2)
+                       break;
+                   }
+               #else
+                   eof = true;
+               #endif
+                 }
+
+               public:
+
+                 size_t type() const final { return runtime::type::edn_reader; }
+
+                 bool equals(var const & o) const final {
+                   return (this == o.get());
+                 }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("edn_reader<");
+                   runtime::print(fd);
+                   runtime::print(">");
+                 }
+               #endif
+
+                 explicit edn_reader(int f) :
+                   fd(f), owner(obj<byte_block>(0)), data(nullptr), pos(0), end(0),
+                   eof(false), failed(false) { }
+
+                 edn_reader(var const & o, const char * d, size_t size) :
+                   fd(-1), owner(o), data(d), pos(0), end(size), eof(true), failed(false) { }
+
+                 // Whether reading stopped at malformed input.
+                 bool malformed() const { return failed; }
+
+                 // False after the last form.
+                 bool next_form(var & form){
+                   lock_guard guard(lock);
+                   for(;;){
+                     edn::parser p(owner, data + pos, data + end, eof);
+                     bool found = p.skip();
+                     if (found)
+                       form = p.form();
+                     edn::status s = p.result();
+
+                     if (s == edn::ok){
+                       pos = (size_t)(p.position() - data);
+                       if (found || eof)
+                         return found;
+                     }else if (s == edn::malformed){
+                       failed = true;
+                       pos = end;
+                       eof = true;
+                       return false;
+                     }
+                     refill();
+                   }
+                 }
+               };
+
+               class edn_sequence final : public object, public seekable_i {
+                 const var reader;
+                 const var form;
+                 mutable var next;
+                 mutable bool realized;
+                 mutable mutex lock;
+               public:
+
+                 size_t type() const final { return runtime::type::edn_sequence; }
+
+                 bool equals(var const & o) const final {
+                   if(first() != runtime::first(o))
+                     return false;
+
+                   for(auto const& it : runtime::range_pair(rest(),runtime::rest(o)))
+                     if (it.first != it.second)
+                       return false;
+
+                   return true;
+                 }
+
+                 size_t hash() const final { return runtime::hash_ordered(var((object*)this)); }
+
+               #if !defined(FERRET_DISABLE_STD_OUT)
+                 void stream_console() const final {
+                   runtime::print("(");
+                   form.stream_console();
+                   for(auto const& i : runtime::range(rest())){
+                     runtime::print(" ");
+                     i.stream_console();
+                   }
+                   runtime::print(")");
+                 }
+               #endif
+
+                 explicit edn_sequence(var const & r, var const & f) :
+                   reader(r), form(f), realized(false) { }
+
+                 static var from(var const & reader){
+                   var f;
+                   if (!reader.cast<edn_reader>()->next_form(f))
+                     return cached::empty_sequence;
+                   return obj<edn_sequence>(reader, f);
+                 }
+
+                 virtual seekable_i* cast_seekable_i() { return this; }
+
+                 var cons(var const & x) final {
+                   return runtime::make_cell(x, var(this));
+                 }
+
+                 var first() const final {
+                   return form;
+                 }
+
+                 var rest() const final {
+                   lock_guard guard(lock);
+                   if (!realized){
+                     next = from(reader);
+                     realized = true;
+                   }
+                   return next;
+                 }
+               };
+
+               // Consume with first/rest rather than runtime::range to keep
+               // memory constant, range holds on to the head of the sequence.
+               namespace runtime {
+               #if defined(FERRET_POSIX)
+                 inline var edn_seq(int fd = 0){
+                   return edn_sequence::from(obj<edn_reader>(fd));
+                 }
+               #endif
+
+                 // Forms of a text. Slices and mapped files are read in
+                 // place, other texts are copied once.
+                 inline var read_edn(var const & text){
+                   var owner = text;
+                   const char * data = nullptr;
+                   size_t size = 0;
+                   if (!text.is_nil() && text.is_type(type::string_slice)){
+                     data = text.cast<string_slice>()->begin();
+                     size = text.cast<string_slice>()->length();
+                 #if defined(FERRET_POSIX)
+                   }else if (!text.is_nil() && text.is_type(type::mapped_file)){
+                     data = text.cast<mapped_file>()->data();
+                     size = text.cast<mapped_file>()->size();
+                 #endif
+                   }else{
+                     text_view t(text);
+                     owner = obj<byte_block>(t.size());
+                     data = owner.cast<byte_block>()->data();
+                     size = t.size();
+                     ::memcpy((char *)data, t.data(), size);
+                   }
+                   return edn_sequence::from(obj<edn_reader>(owner, data, size));
+                 }
+
+                 // First form of a text, nil if there is none.
+                 inline var read_string(var const & text){
+                   return first(read_edn(text));
+                 }
+               }
+               #endif
+               #endif
+        }
+
+        namespace f { 
+         using namespace ferret;
+         typedef ferret::boolean boolean; 
+        }
+
+        // Symbols
+        namespace f{
+        }
+
+
+        // Runtime Implementations
+        #ifndef FERRET_RUNTIME_CPP
+        #define FERRET_RUNTIME_CPP
+
+         namespace ferret{
+           namespace runtime{
+             var first(var const & coll){
+               if (coll.is_nil() || coll.is_type(runtime::type::empty_sequence))
+                 return nil();
+           #if defined(FERRET_COMPACT_CONS)
+               if (coll.is_type(runtime::type::cons_cell))
+                 return coll.cast<cons_cell>()->first();
+           #endif
+               return coll.cast<seekable_i>()->first();
+             }
+           
+             var rest(var const & coll){
+               if (coll.is_nil())
+                 return runtime::list();
+               if (coll.is_type(runtime::type::empty_sequence))
+                 return nil();
+           #if defined(FERRET_COMPACT_CONS)
+               if (coll.is_type(runtime::type::cons_cell))
+                 return coll.cast<cons_cell>()->rest();
+           #endif
+               return coll.cast<seekable_i>()->rest();
+             }
+           
+             var cons(var const & x, var const & coll){
+               if (coll.is_nil() || coll == runtime::list())
+                 return runtime::list(x);
+           #if defined(FERRET_COMPACT_CONS)
+               if (coll.is_type(runtime::type::cons_cell))
+                 return make_cell(x, coll);
+           #endif
+           
+               return coll.cast<seekable_i>()->cons(x);
+             }
+           
+             var nth(var const & seq, number_t index){
+               size_t n;
+               if (index < 0)
+                 return nil();
+               if (known_count(seq, n) && (size_t)index >= n)
+                 return nil();
+               if (seq.is_type(runtime::type::integer_range))
+                 return seq.cast<integer_range>()->nth((size_t)index);
+
+               for(auto const& i : range_indexed(seq))
+                 if (index == i.index)
+                   return i.value;
+           
+               return nil();
+             }
+           
+             var nthrest(var const & seq, number_t index){
+               size_t n;
+               if (index > 0 && known_count(seq, n) && (size_t)index >= n)
+                 return runtime::list();
+               if (index > 0 && seq.is_type(runtime::type::integer_range))
+                 return seq.cast<integer_range>()->nthrest((size_t)index);
+
+               var ret = seq;
+               for(number_t i = 0; i < index; i++)
+                 ret = runtime::rest(ret);
+           
+               if (ret.is_nil())
+                 return runtime::list(); 
+           
+               return ret;
+             }
+             
+             // Walks until the rest is a counted collection.
+             size_t count(var const & seq){
+               size_t acc = 0;
+               size_t n;
+               for(runtime::range it(seq); it != it.end(); ++it){
+                 if (known_count(it.p, n))
+                   return acc + n;
+                 acc++;
+               }
+               return acc;
+             }
+           
+             bool is_seqable(var const & seq){
+           #if defined(FERRET_COMPACT_CONS)
+               if (seq.is_type(runtime::type::cons_cell))
+                 return true;
+           #endif
+               if(seq.cast<seekable_i>())
+                 return true;
+               else
+                 return false;
+             }
+
+             bool reduce(reducer_i & rf, var & acc, var const & coll){
+               if (coll.is_nil() || coll.is_type(runtime::type::empty_sequence))
+                 return true;
+
+               if (coll.get()->reducible())
+                 return coll.get()->reduce(rf, acc);
+
+               for(var it = coll;
+                   !it.is_nil() && !it.is_type(runtime::type::empty_sequence);
+                   it = runtime::rest(it))
+                 if (!rf.step(acc, runtime::first(it)))
+                   return false;
+               return true;
+             }
+
+             var reduce(var const & f, var const & init, var const & coll){
+               var acc = init;
+               fn_reducer rf(f);
+               reduce(rf, acc, coll);
+               rf.complete(acc);
+               return acc;
+             }
+
+             // Every call of a function value goes through here so it is
+             // traced.
+             inline var apply(var const & fn, var const & args){
+               FERRET_TRACE_SCOPE(typeid(*fn.get()));
+               return fn.cast<lambda_i>()->invoke(args);
+             }
+           }
+           template<typename T, typename... Args>
+           inline var run(T const & fn, Args const & ... args) {
+             FERRET_TRACE_SCOPE(typeid(T));
+             return fn.invoke(runtime::list(args...));
+           }
+           
+           template<typename T>
+           inline var run(T const & fn) {
+             FERRET_TRACE_SCOPE(typeid(T));
+             return fn.invoke(nil());
+           }
+           
+           template<>
+           inline var run(var const & fn) {
+             return runtime::apply(fn, nil());
+           }
+           
+           template<typename... Args>
+           inline var run(var const & fn, Args const & ... args) {
+             return runtime::apply(fn, runtime::list(args...));
+           }
+         }
+        #endif
+
+        // Lambda Prototypes
+        namespace f{
+                 class second  {
+                public:
+
+                  var invoke (var const & _args_) const  ;
+                };
 
                  class apply  {
                 public:
@@ -2135,8 +10713,7 @@
 
         // Command Line Arguments
         #if defined(FERRET_STD_LIB) &&               \
-            !defined(FERRET_DISABLE_CLI_ARGS) &&     \
-            !defined(FERRET_DISABLE_STD_MAIN)
+            !defined(FERRET_DISABLE_CLI_ARGS)
           ferret::var _star_command_line_args_star_;
         #endif
 
@@ -2158,7 +10735,7 @@
                   const var args = runtime::first(runtime::rest(_args_));
              
                   var __result;
-                  __result = f.cast<lambda_i>()->invoke(args);;
+                  __result = runtime::apply(f, args);;
                   return __result;
                 }
                
@@ -2242,6 +10819,10 @@
            #if defined(FERRET_PROGRAM_MAIN)
             run(FERRET_PROGRAM_MAIN);
            #endif
+
+           #if defined(FERRET_ENABLE_TRACE)
+            trace::dump();
+           #endif
              
             return 0;
           }